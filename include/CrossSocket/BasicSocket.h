@@ -0,0 +1,536 @@
+#ifndef __BASIC_SOCKET_H
+#define __BASIC_SOCKET_H
+
+#include "CrossSocketUtils.h"
+
+#include <cerrno>
+#include <stdexcept>
+#include <string>
+
+#ifndef _WIN32
+#include <poll.h>
+#endif // _WIN32
+
+namespace CrossSocket
+{
+#ifdef _WIN32
+	/**
+	 * @brief I/O backend for Winsock
+	 */
+	struct WinsockBackend
+	{
+		/**
+		 * @brief Start Winsock once per process
+		 *
+		 * @return True if Winsock is ready
+		 */
+		static bool Initialize()
+		{
+			static const bool started = []()
+			{
+				WSADATA data;
+				return WSAStartup(MAKEWORD(2, 2), &data) == 0;
+			}();
+			return started;
+		}
+
+		static int LastError() { return WSAGetLastError(); }
+		static void Close(socket_t socket) { closesocket(socket); }
+
+		static int SetNonblocking(socket_t socket, bool enable)
+		{
+			u_long mode = enable ? 1 : 0;
+			return ioctlsocket(socket, FIONBIO, &mode) == 0 ? 0 : SOCKET_ERROR;
+		}
+
+		static int Send(socket_t socket, const char *buf, int len, int flags) { return send(socket, buf, len, flags); }
+		static int SendTo(socket_t socket, const char *buf, int len, int flags, const sockaddr *to, int tolen) { return sendto(socket, buf, len, flags, to, tolen); }
+		static int Receive(socket_t socket, char *buf, int len, int flags) { return recv(socket, buf, len, flags); }
+		static int ReceiveFrom(socket_t socket, char *buf, int len, int flags, sockaddr *from, int *fromlen) { return recvfrom(socket, buf, len, flags, from, fromlen); }
+
+		/**
+		 * @brief Wait until a socket is ready
+		 *
+		 * @param socket Socket to wait on
+		 * @param write True to wait for write readiness. False for read readiness
+		 * @param timeoutMillis Timeout in milliseconds
+		 * @return 1 if ready, 0 on timeout, SOCKET_ERROR on failure
+		 */
+		static int Wait(socket_t socket, bool write, int timeoutMillis)
+		{
+			fd_set set{};
+			FD_ZERO(&set);
+			FD_SET(socket, &set);
+			timeval timeout{};
+			timeout.tv_sec = timeoutMillis / 1000;
+			timeout.tv_usec = (timeoutMillis % 1000) * 1000;
+			return select(0, write ? nullptr : &set, write ? &set : nullptr, nullptr, &timeout);
+		}
+	};
+#else
+	/**
+	 * @brief I/O backend for Berkeley sockets
+	 */
+	struct PosixBackend
+	{
+		static bool Initialize() { return true; }
+		static int LastError() { return errno; }
+		static void Close(socket_t socket) { close(socket); }
+
+		static int SetNonblocking(socket_t socket, bool enable)
+		{
+			int flags = fcntl(socket, F_GETFL, 0);
+			if (flags == -1)
+			{
+				return SOCKET_ERROR;
+			}
+			flags = enable ? (flags | O_NONBLOCK) : (flags & ~O_NONBLOCK);
+			return fcntl(socket, F_SETFL, flags) == -1 ? SOCKET_ERROR : 0;
+		}
+
+		static int Send(socket_t socket, const char *buf, int len, int flags) { return static_cast<int>(send(socket, buf, static_cast<size_t>(len), flags)); }
+		static int SendTo(socket_t socket, const char *buf, int len, int flags, const sockaddr *to, int tolen) { return static_cast<int>(sendto(socket, buf, static_cast<size_t>(len), flags, to, static_cast<socklen_t>(tolen))); }
+		static int Receive(socket_t socket, char *buf, int len, int flags) { return static_cast<int>(recv(socket, buf, static_cast<size_t>(len), flags)); }
+
+		static int ReceiveFrom(socket_t socket, char *buf, int len, int flags, sockaddr *from, int *fromlen)
+		{
+			socklen_t addrlen = fromlen != nullptr ? static_cast<socklen_t>(*fromlen) : 0;
+			int received = static_cast<int>(recvfrom(socket, buf, static_cast<size_t>(len), flags, from, fromlen != nullptr ? &addrlen : nullptr));
+			if (fromlen != nullptr)
+			{
+				*fromlen = static_cast<int>(addrlen);
+			}
+			return received;
+		}
+
+		/**
+		 * @brief Wait until a socket is ready. Uses poll(), so descriptors above FD_SETSIZE work
+		 *
+		 * @param socket Socket to wait on
+		 * @param write True to wait for write readiness. False for read readiness
+		 * @param timeoutMillis Timeout in milliseconds
+		 * @return 1 if ready, 0 on timeout, SOCKET_ERROR on failure
+		 */
+		static int Wait(socket_t socket, bool write, int timeoutMillis)
+		{
+			pollfd entry{socket, static_cast<short>(write ? POLLOUT : POLLIN), 0};
+			return poll(&entry, 1, timeoutMillis);
+		}
+	};
+#endif // _WIN32
+
+	/**
+	 * @brief Backend for the platform being compiled for. Chosen here once, so nothing branches on the platform at runtime
+	 */
+#ifdef _WIN32
+	using DefaultBackend = WinsockBackend;
+#else
+	using DefaultBackend = PosixBackend;
+#endif // _WIN32
+
+	/**
+	 * @brief Error policy that throws std::runtime_error, like Socket
+	 */
+	struct ThrowOnError
+	{
+		static int Fail(const char *message, int errorCode)
+		{
+			throw std::runtime_error(std::string(message) + " " + std::to_string(errorCode));
+		}
+	};
+
+	/**
+	 * @brief Error policy that returns SOCKET_ERROR instead of throwing. The error code is kept for BasicSocket::GetLastError()
+	 */
+	struct ReturnErrorCode
+	{
+		static int Fail(const char *, int)
+		{
+			return SOCKET_ERROR;
+		}
+	};
+
+	/**
+	 * @brief Header-only Socket with its I/O backend and error handling chosen at compile time
+	 *
+	 * Every member is defined here, so calls inline into the caller and the backend costs nothing at runtime.
+	 * Operations that can fail return 0 (or a byte count) on success and ErrorPolicy::Fail() on failure. Unlike Socket,
+	 * a failure does not close the Socket. It has no send queue, rate limits, or timestamps; use Socket for those
+	 *
+	 * @tparam Backend I/O backend (PosixBackend or WinsockBackend)
+	 * @tparam ErrorPolicy ThrowOnError or ReturnErrorCode
+	 */
+	template <typename Backend = DefaultBackend, typename ErrorPolicy = ThrowOnError>
+	class BasicSocket
+	{
+	public:
+		using BackendType = Backend;
+		using ErrorPolicyType = ErrorPolicy;
+
+		/**
+		 * @brief Create a new TCP/IPv4 Socket
+		 */
+		BasicSocket() : BasicSocket(AF_INET, SOCK_STREAM, 0) {}
+		/**
+		 * @brief Create a new Socket with a specific address family and type. Check IsValid() under ReturnErrorCode
+		 *
+		 * @param family Address family (AF_INET, AF_INET6, AF_UNIX, ...)
+		 * @param type Socket type (SOCK_STREAM, SOCK_DGRAM, ...)
+		 * @param protocol Protocol (if no value passed, 0)
+		 */
+		BasicSocket(int family, int type, int protocol = 0) : mSocket(INVALID_SOCKET), mLastError(0)
+		{
+			if (!Backend::Initialize())
+			{
+				Fail("Socket library initialization failed");
+				return;
+			}
+			mSocket = socket(family, type, protocol);
+			if (mSocket == INVALID_SOCKET)
+			{
+				Fail("Socket creation failed");
+			}
+		}
+		/**
+		 * @brief Wrap an existing socket
+		 *
+		 * @param existingSocket Socket to wrap
+		 */
+		explicit BasicSocket(socket_t existingSocket) : mSocket(existingSocket), mLastError(0) {}
+		/**
+		 * @brief Take over another Socket. The other Socket is left closed
+		 *
+		 * @param other Socket to take over
+		 */
+		BasicSocket(BasicSocket &&other) noexcept : mSocket(other.mSocket), mLastError(other.mLastError)
+		{
+			other.mSocket = INVALID_SOCKET;
+		}
+		/**
+		 * @brief Close this Socket and take over another. The other Socket is left closed
+		 *
+		 * @param other Socket to take over
+		 * @return This Socket
+		 */
+		BasicSocket &operator=(BasicSocket &&other) noexcept
+		{
+			if (this != &other)
+			{
+				Close();
+				mSocket = other.mSocket;
+				mLastError = other.mLastError;
+				other.mSocket = INVALID_SOCKET;
+			}
+			return *this;
+		}
+		// A copy would close the same socket twice
+		BasicSocket(const BasicSocket &) = delete;
+		BasicSocket &operator=(const BasicSocket &) = delete;
+		/**
+		 * @brief Destructor. Closes the Socket
+		 */
+		~BasicSocket()
+		{
+			Close();
+		}
+
+		/**
+		 * @brief Shut down and close the Socket. Does nothing if it is already closed
+		 */
+		void Close()
+		{
+			if (mSocket != INVALID_SOCKET)
+			{
+				shutdown(mSocket, 2);
+				Backend::Close(mSocket);
+				mSocket = INVALID_SOCKET;
+			}
+		}
+
+		/**
+		 * @brief Disable sends and/or receives on the socket
+		 *
+		 * @param how Flag that determines what operation to disable. 0-RECEIVE, 1-SEND, 2-BOTH (if no value passed, 2)
+		 */
+		void Shutdown(int how = 2) const
+		{
+			if (mSocket != INVALID_SOCKET)
+			{
+				shutdown(mSocket, how);
+			}
+		}
+
+		/**
+		 * @brief Switch between blocking (default) and nonblocking mode
+		 *
+		 * @param enable True to enable nonblocking mode. False to enable code blocking
+		 * @return 0 on success
+		 */
+		int SetNonblockingMode(bool enable)
+		{
+			return Backend::SetNonblocking(mSocket, enable) == 0 ? 0 : Fail("Failed to set non-blocking mode");
+		}
+
+		/**
+		 * @brief Connect a CLIENT Socket to an address. A nonblocking connect that is still in progress counts as success
+		 *
+		 * @param address Address to connect to
+		 * @param addrlen Size (in bytes) of the address
+		 * @return 0 on success
+		 */
+		int ConnectTo(const sockaddr *address, int addrlen)
+		{
+			if (connect(mSocket, address, addrlen) == SOCKET_ERROR)
+			{
+				int error = Backend::LastError();
+				if (error != CSEWOULDBLOCK && error != CSEINPROGRESS && error != CSEALREADY)
+				{
+					return Fail("Connection failed with error", error);
+				}
+			}
+			return 0;
+		}
+
+		/**
+		 * @brief Bind a SERVER Socket to an address
+		 *
+		 * @param address Address to bind to
+		 * @param addrlen Size (in bytes) of the address
+		 * @return 0 on success
+		 */
+		int BindTo(const sockaddr *address, int addrlen)
+		{
+			return bind(mSocket, address, addrlen) == SOCKET_ERROR ? Fail("Bind failed with error") : 0;
+		}
+
+		/**
+		 * @brief Bind a SERVER Socket to a port on every local IPv4 address
+		 *
+		 * @param port Port to bind to
+		 * @return 0 on success
+		 */
+		int BindTo(u_short port)
+		{
+			sockaddr_in addr{};
+			addr.sin_family = AF_INET;
+			addr.sin_addr.s_addr = htonl(INADDR_ANY);
+			addr.sin_port = htons(port);
+			return BindTo(reinterpret_cast<const sockaddr *>(&addr), sizeof(addr));
+		}
+
+		/**
+		 * @brief Tell the SERVER Socket to listen for connections
+		 *
+		 * @param backlog Maximum length of the queue of pending connections (if no value passed, 5)
+		 * @return 0 on success
+		 */
+		int Listen(int backlog = 5)
+		{
+			return listen(mSocket, backlog) == SOCKET_ERROR ? Fail("Listen failed with error") : 0;
+		}
+
+		/**
+		 * @brief Accept a connection to a SERVER Socket
+		 *
+		 * @return Connected CLIENT Socket. Not valid if no connection was waiting or accepting failed
+		 */
+		BasicSocket AcceptConnection()
+		{
+			socket_t client = accept(mSocket, nullptr, nullptr);
+			if (client == INVALID_SOCKET)
+			{
+				int error = Backend::LastError();
+				if (error != CSEWOULDBLOCK)
+				{
+					Fail("Accept failed", error);
+				}
+			}
+			return BasicSocket(client);
+		}
+
+		/**
+		 * @brief Check if the Socket is ready to read data
+		 *
+		 * @param timeoutMillis Timeout for check in milliseconds
+		 * @return Socket read readiness
+		 */
+		bool IsReadyToRead(int timeoutMillis = 0)
+		{
+			int result = Backend::Wait(mSocket, false, timeoutMillis);
+			if (result < 0)
+			{
+				Fail("Wait failed on read check");
+				return false;
+			}
+			return result > 0;
+		}
+
+		/**
+		 * @brief Check if the Socket is ready to send data
+		 *
+		 * @param timeoutMillis Timeout for check in milliseconds
+		 * @return Socket write readiness
+		 */
+		bool IsReadyToWrite(int timeoutMillis = 0)
+		{
+			int result = Backend::Wait(mSocket, true, timeoutMillis);
+			if (result < 0)
+			{
+				Fail("Wait failed on write check");
+				return false;
+			}
+			return result > 0;
+		}
+
+		/**
+		 * @brief Send data through a TCP connection. Blocking Sockets send everything. Nonblocking Sockets send what fits
+		 *
+		 * If sending fails after part of the data went out, the bytes sent are returned and the error is kept for GetLastError().
+		 * The error policy only sees an error when nothing was sent, so a partial send is never lost
+		 *
+		 * @param buf Data to send
+		 * @param len Size (in bytes) of the data to send
+		 * @param flags Sending flags
+		 * @return Number of bytes sent
+		 */
+		int Send(const char *buf, int len, int flags)
+		{
+			int totalSent = 0;
+			while (totalSent < len)
+			{
+				int sent = Backend::Send(mSocket, buf + totalSent, len - totalSent, flags);
+				if (sent == SOCKET_ERROR)
+				{
+					int error = Backend::LastError();
+					if (error == CSEWOULDBLOCK)
+					{
+						break;
+					}
+					if (totalSent > 0)
+					{
+						mLastError = error;
+						break;
+					}
+					return Fail("Send failed with error", error);
+				}
+				totalSent += sent;
+			}
+			return totalSent;
+		}
+
+		/**
+		 * @brief Send data through a UDP connection
+		 *
+		 * @param buf Data to send
+		 * @param len Size (in bytes) of the data to send
+		 * @param flags Sending flags
+		 * @param to Destination address
+		 * @param tolen Size (in bytes) of destination address
+		 * @return Number of bytes sent
+		 */
+		int Send(const char *buf, int len, int flags, const sockaddr *to, int tolen)
+		{
+			int sent = Backend::SendTo(mSocket, buf, len, flags, to, tolen);
+			return sent == SOCKET_ERROR ? Fail("SendTo failed with error") : sent;
+		}
+
+		/**
+		 * @brief Receive data through a TCP connection
+		 *
+		 * @param buf Destination to store data
+		 * @param len Size (in bytes) of the data received
+		 * @param flags Receiving flags
+		 * @return Data size in bytes
+		 */
+		int Receive(char *buf, int len, int flags)
+		{
+			int bytesReceived = 0;
+			while (bytesReceived < len)
+			{
+				int received = Backend::Receive(mSocket, buf + bytesReceived, len - bytesReceived, flags);
+				if (received == 0)
+				{
+					break;
+				}
+				else if (received == SOCKET_ERROR)
+				{
+					int error = Backend::LastError();
+					if (error == CSEWOULDBLOCK || error == CSEINPROGRESS || error == CSEALREADY)
+					{
+						break;
+					}
+					return Fail("Recv failed with error", error);
+				}
+				bytesReceived += received;
+			}
+			return bytesReceived;
+		}
+
+		/**
+		 * @brief Receive data through a UDP connection
+		 *
+		 * @param buf Destination to store data
+		 * @param len Size (in bytes) of the data received
+		 * @param flags Receiving flags
+		 * @param from Source address
+		 * @param fromlen Size (in bytes) of the source address
+		 * @return Data size in bytes
+		 */
+		int Receive(char *buf, int len, int flags, sockaddr *from, int *fromlen)
+		{
+			int received = Backend::ReceiveFrom(mSocket, buf, len, flags, from, fromlen);
+			return received == SOCKET_ERROR ? Fail("RecvFrom failed with error") : received;
+		}
+
+		/**
+		 * @brief Return the unwrapped socket
+		 *
+		 * @return Socket in its lowest-level form
+		 */
+		socket_t GetRawSocket() const { return mSocket; }
+
+		/**
+		 * @brief Check if the Socket holds an open socket
+		 *
+		 * @return True if the socket is open
+		 */
+		bool IsValid() const { return mSocket != INVALID_SOCKET; }
+
+		/**
+		 * @brief Return the error code of the last failed operation
+		 *
+		 * @return Error code (0 if nothing has failed)
+		 */
+		int GetLastError() const { return mLastError; }
+
+	private:
+		socket_t mSocket;
+		int mLastError;
+
+		/**
+		 * @brief Record the current error and hand it to the error policy
+		 *
+		 * @param message Error message
+		 * @return Whatever the error policy returns
+		 */
+		int Fail(const char *message)
+		{
+			return Fail(message, Backend::LastError());
+		}
+
+		/**
+		 * @brief Record an error and hand it to the error policy
+		 *
+		 * @param message Error message
+		 * @param errorCode Error code
+		 * @return Whatever the error policy returns
+		 */
+		int Fail(const char *message, int errorCode)
+		{
+			mLastError = errorCode;
+			return ErrorPolicy::Fail(message, errorCode);
+		}
+	};
+}
+
+#endif // __BASIC_SOCKET_H
@@ -0,0 +1,216 @@
+#ifndef __BASIC_SOCKET_MANAGER_H
+#define __BASIC_SOCKET_MANAGER_H
+
+#include "BasicSocket.h"
+
+#include <vector>
+
+namespace CrossSocket
+{
+    /**
+     * @brief Header-only event loop for BasicSocket, with the Socket type (and so its backend and error policy) chosen at compile time
+     *
+     * Covers the core of SocketManager: watching Sockets for reads and writes and running their callbacks.
+     * Each Socket type gets its own Singleton. A select() failure is reported through the Socket type's error policy
+     *
+     * @tparam SocketType A BasicSocket specialization
+     */
+    template <typename SocketType>
+    class BasicSocketManager
+    {
+    public:
+        using Callback = void (*)(SocketType &);
+
+        /**
+         * @brief Get BasicSocketManager Singleton object
+         *
+         * @return BasicSocketManager Singleton
+         */
+        static BasicSocketManager *Instance()
+        {
+            if (sInstance == nullptr)
+            {
+                sInstance = new BasicSocketManager();
+            }
+            return sInstance;
+        }
+
+        /**
+         * @brief Free memory used by the Singleton
+         */
+        void Release()
+        {
+            delete sInstance;
+            sInstance = nullptr;
+        }
+
+        /**
+         * @brief Add a Socket to the event loop. The Socket must not be moved or destroyed while it is watched
+         *
+         * @param socket Socket to add
+         * @param monitorRead Boolean to enable listening for data receiving
+         * @param monitorWrite Boolean to enable listening for data sending
+         * @param onRead Function pointer to callback upon data receiving (must take SocketType& as only parameter)
+         * @param onWrite Function pointer to callback upon data sending (must take SocketType& as only parameter)
+         * @return Socket ID in vector
+         */
+        int AddSocket(SocketType &socket, bool monitorRead, bool monitorWrite, Callback onRead = nullptr, Callback onWrite = nullptr)
+        {
+            sockets.push_back(WatchedSocket{&socket, static_cast<int>(sockets.size()), monitorRead, monitorWrite, onRead, onWrite});
+            return static_cast<int>(sockets.size()) - 1;
+        }
+
+        /**
+         * @brief Check all watched Sockets for updates
+         *
+         * @param timeoutMillis Timeout for check in milliseconds
+         * @return Number of callbacks run, or SOCKET_ERROR if select() failed under ReturnErrorCode
+         */
+        int RunOnce(int timeoutMillis = 1000)
+        {
+            fd_set readSet{}, writeSet{};
+            FD_ZERO(&readSet);
+            FD_ZERO(&writeSet);
+            socket_t maxFd = 0;
+
+            for (WatchedSocket &ws : sockets)
+            {
+                socket_t s = ws.socket->GetRawSocket();
+                if (ws.monitorRead)
+                {
+                    FD_SET(s, &readSet);
+                }
+                if (ws.monitorWrite)
+                {
+                    FD_SET(s, &writeSet);
+                }
+                if (s > maxFd)
+                {
+                    maxFd = s;
+                }
+            }
+
+            timeval timeout{};
+            timeout.tv_sec = timeoutMillis / 1000;
+            timeout.tv_usec = (timeoutMillis % 1000) * 1000;
+
+            if (select(static_cast<int>(maxFd + 1), &readSet, &writeSet, nullptr, &timeout) == SOCKET_ERROR)
+            {
+                return SocketType::ErrorPolicyType::Fail("select() failed in event loop", SocketType::BackendType::LastError());
+            }
+
+            // The order is fixed before any callback runs, since callbacks may close Sockets and shift the ones after them
+            dispatchOrder.clear();
+            for (size_t i = 0; i < sockets.size(); ++i)
+            {
+                dispatchOrder.push_back(DispatchEntry{sockets[i].socket, i});
+            }
+
+            int dispatched = 0;
+            for (const DispatchEntry &entry : dispatchOrder)
+            {
+                // Closing only moves Sockets to lower indices, so search down from where this one started. Closed Sockets are not found
+                size_t i = entry.index < sockets.size() ? entry.index + 1 : sockets.size();
+                while (i > 0 && sockets[i - 1].socket != entry.socket)
+                {
+                    --i;
+                }
+                if (i == 0)
+                {
+                    continue;
+                }
+                --i;
+
+                SocketType *socket = sockets[i].socket;
+                Callback onWrite = sockets[i].onWrite;
+                bool writeReady = sockets[i].monitorWrite && FD_ISSET(socket->GetRawSocket(), &writeSet);
+
+                if (sockets[i].monitorRead && sockets[i].onRead && FD_ISSET(socket->GetRawSocket(), &readSet))
+                {
+                    sockets[i].onRead(*socket);
+                    ++dispatched;
+                }
+                if (writeReady && onWrite && socket->IsValid())
+                {
+                    onWrite(*socket);
+                    ++dispatched;
+                }
+            }
+            return dispatched;
+        }
+
+        /**
+         * @brief Continuously check all watched Sockets for updates
+         *
+         * @param condition Reference to a boolean value which controls the event loop. When the value is false, the loop will stop. If no pointer is passed, the loop with continue infintely
+         */
+        void RunLoop(bool *condition = nullptr)
+        {
+            while (condition == nullptr || *condition)
+            {
+                RunOnce();
+            }
+        }
+
+        /**
+         * @brief Remove a socket from the event loop
+         *
+         * @param id Socket ID to remove
+         */
+        void CloseSocket(int id)
+        {
+            sockets[id].socket->Close();
+            for (size_t i = static_cast<size_t>(id); i < sockets.size(); ++i)
+            {
+                --sockets[i].id;
+            }
+            sockets.erase(sockets.begin() + id);
+        }
+
+        /**
+         * @brief Close all sockets in event loop
+         */
+        void CloseSockets()
+        {
+            for (WatchedSocket &ws : sockets)
+            {
+                ws.socket->Close();
+            }
+            sockets.clear();
+        }
+
+    private:
+        static inline BasicSocketManager *sInstance = nullptr;
+
+        /**
+         * @brief BasicSocketManager initialization. Private in order to ensure Singleton
+         */
+        BasicSocketManager() {}
+        /**
+         * @brief Destructor
+         */
+        ~BasicSocketManager() {}
+
+        struct WatchedSocket
+        {
+            SocketType *socket;
+            int id;
+            bool monitorRead;
+            bool monitorWrite;
+            Callback onRead;
+            Callback onWrite;
+        };
+
+        std::vector<WatchedSocket> sockets;
+
+        struct DispatchEntry
+        {
+            SocketType *socket;
+            size_t index; // Index when the tick started. Sockets closed by callbacks can only move it lower
+        };
+
+        std::vector<DispatchEntry> dispatchOrder; // Reused every tick so dispatching does not allocate
+    };
+}
+
+#endif // __BASIC_SOCKET_MANAGER_H
@@ -1,6 +1,7 @@
 #ifndef __CROSS_SOCKET_UTILS_H
 #define __CROSS_SOCKET_UTILS_H
 
+#include <cstddef>
 #include <cstdint>
 
 #ifdef _WIN32
@@ -24,6 +25,8 @@ using socket_t = SOCKET;
 #include <arpa/inet.h>
 #include <unistd.h>
 #include <netdb.h>
+#include <fcntl.h>
+#include <sys/un.h>
 
 using socket_t = int;
 
@@ -39,6 +42,13 @@ using socket_t = int;
 #define CSERROR errno
 #endif // _WIN32
 
+// Byte order of the host. MSVC only targets little-endian platforms
+#if defined(_WIN32) || (defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+#define CS_LITTLE_ENDIAN 1
+#else
+#define CS_LITTLE_ENDIAN 0
+#endif
+
 namespace CrossSocket
 {
 	class CS_Utils
@@ -73,13 +83,49 @@ namespace CrossSocket
 		}
 
 	public:
+		/**
+		 * @brief Reverse the bytes of a 16-bit value
+		 *
+		 * @param val Value to reverse
+		 * @return Input value with its bytes reversed
+		 */
+		static constexpr uint16_t cs_bswap16(uint16_t val)
+		{
+			return static_cast<uint16_t>((val >> 8) | (val << 8));
+		}
+
+		/**
+		 * @brief Reverse the bytes of a 32-bit value
+		 *
+		 * @param val Value to reverse
+		 * @return Input value with its bytes reversed
+		 */
+		static constexpr uint32_t cs_bswap32(uint32_t val)
+		{
+			return (val >> 24) | ((val >> 8) & 0x0000FF00u) | ((val << 8) & 0x00FF0000u) | (val << 24);
+		}
+
+		/**
+		 * @brief Reverse the bytes of a 64-bit value
+		 *
+		 * @param val Value to reverse
+		 * @return Input value with its bytes reversed
+		 */
+		static constexpr uint64_t cs_bswap64(uint64_t val)
+		{
+			return (static_cast<uint64_t>(cs_bswap32(static_cast<uint32_t>(val))) << 32) | cs_bswap32(static_cast<uint32_t>(val >> 32));
+		}
+
 		/**
 		 * @brief Convert to network byte order (to big-endian)
 		 *
 		 * @param val Value to convert
 		 * @return Input value in big-endian
 		 */
-		static uint32_t cs_htonl(uint32_t val);
+		static constexpr uint16_t cs_htons(uint16_t val)
+		{
+			return CS_LITTLE_ENDIAN ? cs_bswap16(val) : val;
+		}
 
 		/**
 		 * @brief Convert from network byte order (to little-endian)
@@ -87,10 +133,100 @@ namespace CrossSocket
 		 * @param val Value to convert
 		 * @return Input value in little-endian
 		 */
-		static uint32_t cs_ntohl(uint32_t val);
+		static constexpr uint16_t cs_ntohs(uint16_t val)
+		{
+			return cs_htons(val);
+		}
+
+		/**
+		 * @brief Convert to network byte order (to big-endian)
+		 *
+		 * @param val Value to convert
+		 * @return Input value in big-endian
+		 */
+		static constexpr uint32_t cs_htonl(uint32_t val)
+		{
+			return CS_LITTLE_ENDIAN ? cs_bswap32(val) : val;
+		}
+
+		/**
+		 * @brief Convert from network byte order (to little-endian)
+		 *
+		 * @param val Value to convert
+		 * @return Input value in little-endian
+		 */
+		static constexpr uint32_t cs_ntohl(uint32_t val)
+		{
+			return cs_htonl(val);
+		}
+
+		/**
+		 * @brief Convert to network byte order (to big-endian)
+		 *
+		 * @param val Value to convert
+		 * @return Input value in big-endian
+		 */
+		static constexpr uint64_t cs_htonll(uint64_t val)
+		{
+			return CS_LITTLE_ENDIAN ? cs_bswap64(val) : val;
+		}
+
+		/**
+		 * @brief Convert from network byte order (to little-endian)
+		 *
+		 * @param val Value to convert
+		 * @return Input value in little-endian
+		 */
+		static constexpr uint64_t cs_ntohll(uint64_t val)
+		{
+			return cs_htonll(val);
+		}
+
+		/**
+		 * @brief Convert an array to network byte order in place. Uses SSSE3/AVX2 when the CPU supports them
+		 *
+		 * @param values Values to convert
+		 * @param count Number of values
+		 */
+		static void cs_hton_array(uint16_t *values, size_t count);
+		static void cs_hton_array(uint32_t *values, size_t count);
+		static void cs_hton_array(uint64_t *values, size_t count);
+
+		/**
+		 * @brief Convert an array to network byte order into another array. Uses SSSE3/AVX2 when the CPU supports them
+		 *
+		 * @param src Values to convert
+		 * @param dst Destination for the converted values. May be the same as src, but must not partially overlap it
+		 * @param count Number of values
+		 */
+		static void cs_hton_array(const uint16_t *src, uint16_t *dst, size_t count);
+		static void cs_hton_array(const uint32_t *src, uint32_t *dst, size_t count);
+		static void cs_hton_array(const uint64_t *src, uint64_t *dst, size_t count);
+
+		/**
+		 * @brief Convert an array from network byte order in place. Uses SSSE3/AVX2 when the CPU supports them
+		 *
+		 * @param values Values to convert
+		 * @param count Number of values
+		 */
+		static void cs_ntoh_array(uint16_t *values, size_t count) { cs_hton_array(values, count); }
+		static void cs_ntoh_array(uint32_t *values, size_t count) { cs_hton_array(values, count); }
+		static void cs_ntoh_array(uint64_t *values, size_t count) { cs_hton_array(values, count); }
+
+		/**
+		 * @brief Convert an array from network byte order into another array. Uses SSSE3/AVX2 when the CPU supports them
+		 *
+		 * @param src Values to convert
+		 * @param dst Destination for the converted values. May be the same as src, but must not partially overlap it
+		 * @param count Number of values
+		 */
+		static void cs_ntoh_array(const uint16_t *src, uint16_t *dst, size_t count) { cs_hton_array(src, dst, count); }
+		static void cs_ntoh_array(const uint32_t *src, uint32_t *dst, size_t count) { cs_hton_array(src, dst, count); }
+		static void cs_ntoh_array(const uint64_t *src, uint64_t *dst, size_t count) { cs_hton_array(src, dst, count); }
 
 		friend class Socket;
 		friend class SocketManager;
+		friend class Resolver;
 	};
 }
 
@@ -0,0 +1,188 @@
+#ifndef __LOG_H
+#define __LOG_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+// Lowest severity compiled in: 0 Debug, 1 Info, 2 Warning, 3 Error, 4 nothing. Calls below it compile to nothing
+#ifndef CROSSSOCKET_LOG_LEVEL
+#define CROSSSOCKET_LOG_LEVEL 1
+#endif // CROSSSOCKET_LOG_LEVEL
+
+namespace CrossSocket
+{
+	enum class LogLevel : uint8_t
+	{
+		Debug = 0,
+		Info = 1,
+		Warning = 2,
+		Error = 3
+	};
+
+	/**
+	 * @brief One log message before formatting. Records are fixed-size so queuing one is a single copy
+	 */
+	struct LogRecord
+	{
+		const char *format;  // Must outlive the record (a string literal). "{}" marks where each argument goes
+		const void *site;    // Identifies the call site for rate limiting. CS_LOG_*() passes a token of its own for each call
+		uint64_t timestamp;  // Nanoseconds since the Unix epoch
+		int64_t args[4];     // Integer arguments, or offsets into text for string arguments
+		uint32_t suppressed; // Repeats of this message dropped by rate limiting since the last one written
+		uint8_t count;
+		uint8_t unsignedMask; // Bit n set if argument n is unsigned
+		uint8_t stringMask;   // Bit n set if argument n is a string copied into text
+		LogLevel level;
+		char text[96]; // Copies of string arguments, each null-terminated
+	};
+
+	/**
+	 * @brief Asynchronous diagnostic logging
+	 *
+	 * Each thread writes records into its own lock-free ring. A background thread formats them and passes the text to the sink,
+	 * so logging never blocks and never flushes on the calling thread. Records are dropped, not waited for, when a ring is full.
+	 * The same message is written at most RepeatLimit times per second per thread, and the next one written reports how many were dropped.
+	 * Messages count as the same when they come from the same call site, whatever their arguments
+	 */
+	class Log
+	{
+	public:
+		/**
+		 * @brief Receives each formatted message on the drain thread. Must not log
+		 */
+		using Sink = void (*)(LogLevel level, uint64_t timestamp, const char *text, void *userData);
+
+		static constexpr size_t MaxArgs = 4;
+		/**
+		 * @brief Records each thread can queue before new ones are dropped
+		 */
+		static constexpr size_t RingRecords = 1024;
+		/**
+		 * @brief Times the same message may be written per second per thread
+		 */
+		static constexpr uint32_t RepeatLimit = 10;
+
+		/**
+		 * @brief Queue a message. Formatting happens later on the drain thread
+		 *
+		 * @param level Severity
+		 * @param site Address that stays the same for every call from one place and differs between places. Rate limiting is keyed on it
+		 * @param format String literal with a "{}" for each argument
+		 * @param args Integers or C strings. Strings are copied, up to the size of LogRecord::text in total
+		 */
+		template <typename... Args>
+		static void Write(LogLevel level, const void *site, const char *format, const Args &...args)
+		{
+			static_assert(sizeof...(Args) <= MaxArgs, "Too many log arguments");
+			LogRecord record;
+			record.format = format;
+			record.site = site;
+			record.count = 0;
+			record.unsignedMask = 0;
+			record.stringMask = 0;
+			record.level = level;
+			[[maybe_unused]] size_t used = 0; // Unused when there are no arguments
+			(Encode(record, used, args), ...);
+			Commit(record);
+		}
+
+		/**
+		 * @brief Replace where formatted messages go. The default writes to stderr
+		 *
+		 * @param sink Function pointer to call with each message. nullptr restores the default
+		 * @param userData Pointer passed back to the sink untouched
+		 */
+		static void SetSink(Sink sink, void *userData = nullptr);
+
+		/**
+		 * @brief Format and pass every queued record to the sink before returning
+		 */
+		static void Flush();
+
+		/**
+		 * @brief Get the number of records dropped because a ring was full, plus rate-limited repeats that were never reported
+		 *
+		 * @return Dropped record count
+		 */
+		static uint64_t GetDropped();
+
+		/**
+		 * @brief Default sink. Writes "[CrossSocket] LEVEL message" lines to stderr
+		 *
+		 * @param level Severity
+		 * @param timestamp Nanoseconds since the Unix epoch
+		 * @param text Formatted message
+		 * @param userData Unused
+		 */
+		static void StderrSink(LogLevel level, uint64_t timestamp, const char *text, void *userData);
+
+	private:
+		static void Encode(LogRecord &record, size_t &used, const char *str)
+		{
+			size_t len = std::strlen(str);
+			if (len > sizeof(record.text) - used - 1)
+			{
+				len = sizeof(record.text) - used - 1; // A string that does not fit is cut short
+			}
+			std::memcpy(record.text + used, str, len);
+			record.text[used + len] = '\0';
+			record.args[record.count] = static_cast<int64_t>(used);
+			record.stringMask |= static_cast<uint8_t>(1u << record.count);
+			++record.count;
+			used += len;
+			if (used + 1 < sizeof(record.text))
+			{
+				++used; // Once full, later strings share the last terminator and come out empty
+			}
+		}
+
+		template <typename T>
+		static void Encode(LogRecord &record, size_t &used, T value)
+		{
+			static_assert(std::is_integral<T>::value || std::is_enum<T>::value, "Log arguments must be integers or C strings");
+			(void)used;
+			if (std::is_unsigned<T>::value)
+			{
+				record.unsignedMask |= static_cast<uint8_t>(1u << record.count);
+			}
+			record.args[record.count++] = static_cast<int64_t>(value);
+		}
+
+		/**
+		 * @brief Stamp a record and copy it into the calling thread's ring
+		 *
+		 * @param record Record to queue
+		 */
+		static void Commit(LogRecord &record);
+	};
+}
+
+// Each expansion has its own static, whose address identifies the call site
+#define CS_LOG(level, ...)                                                        \
+	do                                                                            \
+	{                                                                             \
+		if constexpr (static_cast<int>(level) >= CROSSSOCKET_LOG_LEVEL)           \
+		{                                                                         \
+			static const char csLogSite = 0;                                      \
+			CrossSocket::Log::Write(level, &csLogSite, __VA_ARGS__);              \
+		}                                                                         \
+	} while (0)
+
+// For helpers that log for their callers: site stands in for the caller, such as a string literal the caller passed
+#define CS_LOG_SITE(level, site, ...)                                             \
+	do                                                                            \
+	{                                                                             \
+		if constexpr (static_cast<int>(level) >= CROSSSOCKET_LOG_LEVEL)           \
+		{                                                                         \
+			CrossSocket::Log::Write(level, site, __VA_ARGS__);                    \
+		}                                                                         \
+	} while (0)
+
+#define CS_LOG_DEBUG(...) CS_LOG(CrossSocket::LogLevel::Debug, __VA_ARGS__)
+#define CS_LOG_INFO(...) CS_LOG(CrossSocket::LogLevel::Info, __VA_ARGS__)
+#define CS_LOG_WARNING(...) CS_LOG(CrossSocket::LogLevel::Warning, __VA_ARGS__)
+#define CS_LOG_ERROR(...) CS_LOG(CrossSocket::LogLevel::Error, __VA_ARGS__)
+
+#endif // __LOG_H
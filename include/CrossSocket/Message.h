@@ -0,0 +1,319 @@
+#ifndef __MESSAGE_H
+#define __MESSAGE_H
+
+#include "CrossSocketUtils.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+namespace CrossSocket
+{
+	/**
+	 * @brief Growable byte queue that is appended at the back and consumed from the front
+	 *
+	 * Storage is kept between uses, so once it has grown to fit the largest message no further allocation happens
+	 */
+	class ByteBuffer
+	{
+	public:
+		/**
+		 * @brief Return the first unconsumed byte
+		 *
+		 * @return Pointer to the start of the data
+		 */
+		char *Data() { return mStorage.data() + mBegin; }
+		const char *Data() const { return mStorage.data() + mBegin; }
+
+		/**
+		 * @brief Return the number of unconsumed bytes
+		 *
+		 * @return Data size in bytes
+		 */
+		size_t Size() const { return mEnd - mBegin; }
+
+		/**
+		 * @brief Return the stream offset of the first unconsumed byte, counting every byte ever consumed
+		 *
+		 * @return Offset of Data()
+		 */
+		size_t StartOffset() const { return mConsumed; }
+
+		/**
+		 * @brief Return the stream offset just past the data. Unlike Size(), consuming bytes does not change it
+		 *
+		 * @return Offset of the next byte to be appended
+		 */
+		size_t EndOffset() const { return mConsumed + Size(); }
+
+		/**
+		 * @brief Return the byte at a stream offset that has not been consumed yet
+		 *
+		 * @param offset Offset between StartOffset() and EndOffset()
+		 * @return Pointer to the byte
+		 */
+		char *At(size_t offset) { return Data() + (offset - mConsumed); }
+
+		/**
+		 * @brief Make room for at least n more bytes without changing the data
+		 *
+		 * @param n Number of bytes
+		 * @return Pointer to the free space after the data
+		 */
+		char *Reserve(size_t n);
+
+		/**
+		 * @brief Return the number of bytes that can be appended without growing
+		 *
+		 * @return Free space in bytes
+		 */
+		size_t Available() const { return mStorage.size() - mEnd; }
+
+		/**
+		 * @brief Grow the data by n bytes, making room first if needed
+		 *
+		 * @param n Number of bytes
+		 * @return Pointer to the first of the new bytes
+		 */
+		char *Append(size_t n);
+
+		/**
+		 * @brief Mark n bytes written directly into the space returned by Reserve() as data
+		 *
+		 * @param n Number of bytes
+		 */
+		void Commit(size_t n) { mEnd += n; }
+
+		/**
+		 * @brief Remove bytes from the front of the data
+		 *
+		 * @param n Number of bytes
+		 */
+		void Consume(size_t n);
+
+		/**
+		 * @brief Remove bytes from the back of the data
+		 *
+		 * @param n Number of bytes
+		 */
+		void Truncate(size_t n) { mEnd -= n; }
+
+		/**
+		 * @brief Remove all data. Storage is kept for reuse
+		 */
+		void Clear()
+		{
+			mConsumed += Size();
+			mBegin = mEnd = 0;
+		}
+
+	private:
+		std::vector<char> mStorage;
+		size_t mBegin = 0;
+		size_t mEnd = 0;
+		size_t mConsumed = 0; // Bytes removed from the front so far. Offsets built on it survive Consume() and the data sliding forward
+	};
+
+	/**
+	 * @brief Immutable, reference-counted bytes that can be queued on many Sockets at once. Freed when the last Socket has sent it
+	 */
+	using SharedPayload = std::shared_ptr<const std::vector<char>>;
+
+	/**
+	 * @brief Copy bytes into a new SharedPayload
+	 *
+	 * @param data Bytes to copy
+	 * @param len Size (in bytes) of the data
+	 * @return Payload holding the bytes
+	 */
+	inline SharedPayload MakePayload(const char *data, size_t len)
+	{
+		return std::make_shared<const std::vector<char>>(data, data + len);
+	}
+
+	/**
+	 * @brief Writes big-endian fields straight into a ByteBuffer
+	 *
+	 * Fields are appended at the end of the buffer. Lengths that are only known later can be reserved
+	 * with ReserveU32() or BeginSection() and filled in once the rest has been written
+	 */
+	class MessageWriter
+	{
+	public:
+		/**
+		 * @brief Start writing at the end of a buffer
+		 *
+		 * @param buffer Buffer to write into
+		 */
+		explicit MessageWriter(ByteBuffer &buffer);
+
+		void WriteU8(uint8_t val);
+		void WriteU16(uint16_t val);
+		void WriteU32(uint32_t val);
+		void WriteU64(uint64_t val);
+		void WriteI32(int32_t val) { WriteU32(static_cast<uint32_t>(val)); }
+		void WriteI64(int64_t val) { WriteU64(static_cast<uint64_t>(val)); }
+		void WriteF32(float val);
+		void WriteF64(double val);
+
+		/**
+		 * @brief Write raw bytes with no length prefix
+		 *
+		 * @param data Bytes to write
+		 * @param len Size (in bytes) of the data
+		 */
+		void WriteBytes(const void *data, size_t len);
+
+		/**
+		 * @brief Write a string with a 32-bit length prefix
+		 *
+		 * @param str String to write
+		 */
+		void WriteString(std::string_view str);
+
+		/**
+		 * @brief Reserve space for a 32-bit field to fill in later with PatchU32()
+		 *
+		 * @return Slot for PatchU32(). Slots are stream offsets, so they stay valid if the buffer is consumed up to the message in between
+		 */
+		size_t ReserveU32();
+
+		/**
+		 * @brief Fill in a field reserved with ReserveU32()
+		 *
+		 * @param slot Slot returned by ReserveU32()
+		 * @param val Value to store
+		 */
+		void PatchU32(size_t slot, uint32_t val);
+
+		/**
+		 * @brief Start a nested section. Its 32-bit length prefix is filled in by EndSection()
+		 *
+		 * @return Slot for EndSection()
+		 */
+		size_t BeginSection() { return ReserveU32(); }
+
+		/**
+		 * @brief Finish a nested section, storing the number of bytes written since BeginSection()
+		 *
+		 * @param slot Slot returned by BeginSection()
+		 */
+		void EndSection(size_t slot);
+
+		/**
+		 * @brief Get space to write n bytes directly, such as with CS_Utils::cs_hton_array()
+		 *
+		 * @param n Number of bytes
+		 * @return Pointer to the space. Only valid until the next write
+		 */
+		char *Extend(size_t n);
+
+		/**
+		 * @brief Return the number of bytes written so far
+		 *
+		 * @return Size in bytes
+		 */
+		size_t Size() const { return mBuffer.EndOffset() - mStart; }
+
+		/**
+		 * @brief Return where the message starts in the buffer
+		 *
+		 * @return Stream offset of the first byte written, usable as a slot if that field was reserved
+		 */
+		size_t Offset() const { return mStart; }
+
+	private:
+		ByteBuffer &mBuffer;
+		size_t mStart; // Stream offset of this message in the buffer
+	};
+
+	/**
+	 * @brief Reads big-endian fields from bytes that stay where they are, such as a Socket's receive buffer
+	 *
+	 * Reading past the end throws std::runtime_error
+	 */
+	class MessageReader
+	{
+	public:
+		/**
+		 * @brief Create an empty reader
+		 */
+		MessageReader() : mData(nullptr), mSize(0), mPos(0) {}
+		/**
+		 * @brief Read from existing bytes
+		 *
+		 * @param data Bytes to read. Must stay valid while the reader is used
+		 * @param size Size (in bytes) of the data
+		 */
+		MessageReader(const char *data, size_t size) : mData(data), mSize(size), mPos(0) {}
+
+		uint8_t ReadU8();
+		uint16_t ReadU16();
+		uint32_t ReadU32();
+		uint64_t ReadU64();
+		int32_t ReadI32() { return static_cast<int32_t>(ReadU32()); }
+		int64_t ReadI64() { return static_cast<int64_t>(ReadU64()); }
+		float ReadF32();
+		double ReadF64();
+
+		/**
+		 * @brief Read raw bytes without copying them
+		 *
+		 * @param len Number of bytes
+		 * @return Pointer to the bytes inside the message
+		 */
+		const char *ReadBytes(size_t len);
+
+		/**
+		 * @brief Read a string with a 32-bit length prefix without copying it
+		 *
+		 * @return View of the string inside the message
+		 */
+		std::string_view ReadString();
+
+		/**
+		 * @brief Read a nested section written with MessageWriter::BeginSection()
+		 *
+		 * @return Reader limited to the section
+		 */
+		MessageReader ReadSection();
+
+		/**
+		 * @brief Return the number of bytes left to read
+		 *
+		 * @return Size in bytes
+		 */
+		size_t Remaining() const { return mSize - mPos; }
+
+		/**
+		 * @brief Return the whole message
+		 *
+		 * @return Pointer to the first byte
+		 */
+		const char *Data() const { return mData; }
+
+		/**
+		 * @brief Return the size of the whole message
+		 *
+		 * @return Size in bytes
+		 */
+		size_t Size() const { return mSize; }
+
+	private:
+		const char *mData;
+		size_t mSize;
+		size_t mPos;
+
+		/**
+		 * @brief Advance past n bytes, throwing if the message is too short
+		 *
+		 * @param n Number of bytes
+		 * @return Pointer to the first of the bytes
+		 */
+		const char *Take(size_t n);
+	};
+}
+
+#endif // __MESSAGE_H
@@ -0,0 +1,100 @@
+#ifndef __RATE_LIMITER_H
+#define __RATE_LIMITER_H
+
+#include <chrono>
+#include <cstdint>
+
+namespace CrossSocket
+{
+	/**
+	 * @brief Counters and settings for the traffic that passes through a rate limit
+	 */
+	struct RateStats
+	{
+		uint64_t bytesSent;
+		uint64_t bytesReceived;
+		uint64_t sendThrottled;    // Times sending was held back because the send limit ran dry. A hold spanning many loop ticks counts once
+		uint64_t receiveThrottled; // Times receiving was held back because the receive limit ran dry. A hold spanning many loop ticks counts once
+		uint64_t sendRate;         // Send limit in bytes per second (0 for no limit)
+		uint64_t receiveRate;      // Receive limit in bytes per second (0 for no limit)
+	};
+
+	/**
+	 * @brief Token bucket that allows a steady number of bytes per second with bounded bursts
+	 *
+	 * The bucket never blocks. Callers ask how much is available, move at most that much, and charge what they moved
+	 */
+	class TokenBucket
+	{
+	public:
+		/**
+		 * @brief Change the rate. The bucket starts full after every change
+		 *
+		 * @param bytesPerSecond Sustained rate. 0 removes the limit
+		 * @param burstBytes Largest burst allowed after an idle period. 0 picks 100 ms worth of the rate
+		 */
+		void SetRate(uint64_t bytesPerSecond, uint64_t burstBytes = 0);
+
+		/**
+		 * @brief Check if the bucket limits anything
+		 *
+		 * @return True if a rate is set
+		 */
+		bool IsLimited() const { return mRate > 0; }
+
+		/**
+		 * @brief Return the sustained rate
+		 *
+		 * @return Rate in bytes per second (0 for no limit)
+		 */
+		uint64_t GetRate() const { return mRate; }
+
+		/**
+		 * @brief Return how many bytes may be moved right now
+		 *
+		 * @return Bytes available. UINT64_MAX if the bucket has no limit
+		 */
+		uint64_t Available();
+
+		/**
+		 * @brief Charge moved bytes against the bucket. Charging more than is available borrows from the next refill
+		 *
+		 * @param bytes Number of bytes moved
+		 */
+		void Consume(uint64_t bytes);
+
+		/**
+		 * @brief Charge bytes only if the bucket can cover them now, for sends that cannot be split such as datagrams
+		 *
+		 * A charge bigger than the burst size goes through once the bucket is full, so it is slowed down rather than refused forever
+		 *
+		 * @param bytes Number of bytes to move
+		 * @return True if the bytes were charged and may be moved
+		 */
+		bool TryConsume(uint64_t bytes);
+
+		/**
+		 * @brief Return how long until a full-sized packet can be moved. Waiting for that much avoids waking up for a trickle of bytes
+		 *
+		 * @return Time in milliseconds (0 if a packet's worth is available now)
+		 */
+		int MillisUntilAvailable();
+
+	private:
+		using Clock = std::chrono::steady_clock;
+
+		static constexpr uint64_t PacketBytes = 1500;
+
+		uint64_t mRate = 0;
+		uint64_t mBurst = 0;
+		double mTokens = 0;
+		Clock::time_point mLast;
+
+		/**
+		 * @brief Add the tokens earned since the last refill, up to the burst size
+		 */
+		void Refill();
+	};
+}
+
+#endif // __RATE_LIMITER_H
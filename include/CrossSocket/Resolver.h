@@ -0,0 +1,199 @@
+#ifndef __RESOLVER_H
+#define __RESOLVER_H
+
+#include "CrossSocketUtils.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace CrossSocket
+{
+	/**
+	 * @brief One address returned by a name lookup, ready to pass to Socket::ConnectTo()
+	 */
+	struct ResolvedAddress
+	{
+		sockaddr_storage address;
+		int length;
+		int family;
+	};
+
+	/**
+	 * @brief Result of a name lookup
+	 */
+	struct Resolution
+	{
+		std::string host;
+		u_short port;
+		int error; // 0 on success, otherwise a getaddrinfo() EAI_* code
+		bool cached;
+		std::vector<ResolvedAddress> addresses;
+	};
+
+	/**
+	 * @brief Resolves host names on background threads and caches the results for a bounded time
+	 *
+	 * Lookups are started from the event loop thread with Resolve() and their callbacks are run from Dispatch(),
+	 * so callbacks never run on a resolver thread. GetNotifyHandle() becomes readable whenever results are waiting
+	 */
+	class Resolver
+	{
+	public:
+		using Callback = void (*)(const Resolution &, void *);
+
+		/**
+		 * @brief Default time (in milliseconds) a successful lookup stays cached
+		 */
+		static constexpr int DefaultCacheTTL = 30000;
+		/**
+		 * @brief Default time (in milliseconds) a failed lookup stays cached
+		 */
+		static constexpr int DefaultNegativeCacheTTL = 5000;
+		/**
+		 * @brief Most lookups kept cached. Once full, the entry closest to expiring makes room for a new one
+		 */
+		static constexpr size_t MaxCacheEntries = 4096;
+
+		/**
+		 * @brief Create a Resolver with no threads running
+		 *
+		 * @param threads Number of lookup threads started on first use
+		 */
+		explicit Resolver(int threads = 2);
+		/**
+		 * @brief Stop all lookup threads. Lookups still in flight are dropped without calling back
+		 */
+		~Resolver();
+
+		Resolver(const Resolver &) = delete;
+		Resolver &operator=(const Resolver &) = delete;
+
+		/**
+		 * @brief Start resolving a host name. The callback runs from a later call to Dispatch()
+		 *
+		 * @param host Host name or numeric address
+		 * @param port Port to store in every returned address
+		 * @param family AF_INET, AF_INET6, or AF_UNSPEC for both
+		 * @param callback Function pointer to call with the result
+		 * @param userData Pointer passed back to the callback untouched
+		 */
+		void Resolve(const char *host, u_short port, int family, Callback callback, void *userData = nullptr);
+
+		/**
+		 * @brief Run callbacks for every finished lookup
+		 *
+		 * @return Number of callbacks run
+		 */
+		int Dispatch();
+
+		/**
+		 * @brief Check if any finished lookups are waiting for Dispatch()
+		 *
+		 * @return True if Dispatch() has work to do
+		 */
+		bool HasPending();
+
+		/**
+		 * @brief Return the socket that becomes readable when lookups finish
+		 *
+		 * @return Notification socket (INVALID_SOCKET until the first Resolve())
+		 */
+		socket_t GetNotifyHandle() const;
+
+		/**
+		 * @brief Set how long lookups stay cached
+		 *
+		 * @param ttlMillis Time for successful lookups in milliseconds. 0 disables caching
+		 * @param negativeTtlMillis Time for failed lookups in milliseconds. 0 disables caching
+		 */
+		void SetCacheTTL(int ttlMillis, int negativeTtlMillis = DefaultNegativeCacheTTL);
+
+		/**
+		 * @brief Remove every cached lookup
+		 */
+		void ClearCache();
+
+	private:
+		using Clock = std::chrono::steady_clock;
+
+		struct Waiter
+		{
+			Callback callback;
+			void *userData;
+		};
+
+		struct Lookup
+		{
+			std::string key;
+			std::string host;
+			u_short port;
+			int family;
+		};
+
+		struct CacheEntry
+		{
+			Resolution result;
+			Clock::time_point expires;
+		};
+
+		struct Finished
+		{
+			std::string key;
+			Resolution result;
+			std::vector<Waiter> waiters;
+		};
+
+		int mThreadCount;
+		std::vector<std::thread> mThreads;
+		bool mStopping;
+
+		std::mutex mMutex;
+		std::condition_variable mWork;
+		std::deque<Lookup> mQueue;
+		std::vector<Finished> mFinished;
+
+		// Only touched on the event loop thread
+		std::unordered_map<std::string, std::vector<Waiter>> mInFlight;
+		std::unordered_map<std::string, CacheEntry> mCache;
+		int mCacheTTL;
+		int mNegativeCacheTTL;
+		size_t mNextSweep; // Cache size that triggers the next sweep for expired entries
+
+		socket_t mNotify;
+
+		/**
+		 * @brief Start the lookup threads and notification socket
+		 */
+		void Start();
+
+		/**
+		 * @brief Lookup thread body
+		 */
+		void Worker();
+
+		/**
+		 * @brief Store a finished lookup, first removing expired entries if the cache has grown enough to be worth sweeping
+		 *
+		 * @param key Cache key of the lookup
+		 * @param result Lookup result
+		 * @param expires Time the entry stops being used
+		 */
+		void CacheResult(const std::string &key, const Resolution &result, Clock::time_point expires);
+
+		/**
+		 * @brief Run getaddrinfo() for one lookup
+		 *
+		 * @param lookup Lookup to run
+		 * @return Lookup result
+		 */
+		static Resolution RunLookup(const Lookup &lookup);
+	};
+}
+
+#endif // __RESOLVER_H
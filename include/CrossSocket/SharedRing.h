@@ -0,0 +1,177 @@
+// NOTE: SHARED RINGS ARE ONLY AVAILABLE ON LINUX. BOTH PEERS MUST BE ON THE SAME HOST
+#ifndef __SHARED_RING_H
+#define __SHARED_RING_H
+
+#include "Socket.h"
+#include "CrossSocketUtils.h"
+
+#include <cstddef>
+
+#ifdef __linux__
+namespace CrossSocket
+{
+	/**
+	 * @brief Same-host transport that moves data through a shared memory ring instead of the kernel
+	 *
+	 * Two SharedRings are paired by passing a memfd and its eventfds over a connected AF_UNIX Socket.
+	 * Each direction is a single-producer/single-consumer ring, so Send() and Receive() only touch
+	 * shared memory unless the other side is asleep and has to be woken through its eventfd.
+	 */
+	class SharedRing
+	{
+	private:
+		struct RingHeader;
+
+		/**
+		 * @brief One direction of the link as seen from this side
+		 */
+		struct Channel
+		{
+			RingHeader *header;
+			char *data;
+			int dataFd;	 // Signalled by the producer when the consumer is asleep waiting for data
+			int spaceFd; // Signalled by the consumer when the producer is asleep waiting for space
+		};
+
+		int mMemFd;
+		void *mMapping;
+		size_t mMappingSize;
+		Channel mTx;
+		Channel mRx;
+		bool mNonblocking;
+		int mSpinCount;
+
+		/**
+		 * @brief Send an error message, close the ring, and throw an exception
+		 *
+		 * @param message Error message. Must be a string literal, since its address keys log rate limiting
+		 * @param errorCode Error code
+		 */
+		void Error(const char *message, int errorCode);
+
+		/**
+		 * @brief Map the shared memory and assign both channels
+		 *
+		 * @param creator True if this side created the memory (and therefore produces into the first ring)
+		 */
+		void Map(bool creator);
+
+		/**
+		 * @brief Wait until a ring position moves away from a value, spinning first and then sleeping on an eventfd
+		 *
+		 * @param channel Channel to wait on
+		 * @param waitForData True to wait for data as the consumer. False to wait for space as the producer
+		 * @param timeoutMillis Maximum time to sleep once spinning gives up (-1 for no limit)
+		 * @return True if the condition was met. False if the wait timed out or the peer closed the ring
+		 */
+		bool Wait(Channel &channel, bool waitForData, int timeoutMillis);
+
+	public:
+		/**
+		 * @brief Default ring capacity (in bytes) for each direction
+		 */
+		static constexpr size_t DefaultCapacity = 1 << 20;
+		/**
+		 * @brief Default number of polls made before a waiting side goes to sleep
+		 */
+		static constexpr int DefaultSpinCount = 2000;
+
+		/**
+		 * @brief Create an unconnected SharedRing
+		 */
+		SharedRing();
+		/**
+		 * @brief SharedRing destructor
+		 */
+		~SharedRing();
+
+		SharedRing(const SharedRing &) = delete;
+		SharedRing &operator=(const SharedRing &) = delete;
+
+		/**
+		 * @brief Create the shared memory and hand it to the peer over a connected AF_UNIX Socket
+		 *
+		 * @param channel Connected AF_UNIX Socket to the peer
+		 * @param capacity Size (in bytes) of each direction. Rounded up to a power of two
+		 */
+		void Offer(Socket &channel, size_t capacity = DefaultCapacity);
+		/**
+		 * @brief Receive shared memory offered by the peer over a connected AF_UNIX Socket
+		 *
+		 * @param channel Connected AF_UNIX Socket to the peer
+		 */
+		void Join(Socket &channel);
+
+		/**
+		 * @brief Close the ring and wake the peer so it can see the close
+		 */
+		void Close();
+
+		/**
+		 * @brief Allow Receive() to return immediately when no data is present (default mode waits for data)
+		 *
+		 * @param enable True to enable nonblocking mode. False to enable waiting
+		 */
+		void SetNonblockingMode(bool enable);
+		/**
+		 * @brief Set how many times a waiting side polls shared memory before sleeping on its eventfd
+		 *
+		 * @param spins Number of polls. 0 to sleep immediately
+		 */
+		void SetSpinCount(int spins);
+
+		/**
+		 * @brief Check if the ring has data to read
+		 *
+		 * @param timeoutMillis Timeout for check in milliseconds
+		 * @return Ring read readiness
+		 */
+		bool IsReadyToRead(int timeoutMillis = 0);
+		/**
+		 * @brief Check if the ring has space to write
+		 *
+		 * @param timeoutMillis Timeout for check in milliseconds
+		 * @return Ring write readiness
+		 */
+		bool IsReadyToWrite(int timeoutMillis = 0);
+
+		/**
+		 * @brief Send data to the peer. Waits for space until all of the data has been written
+		 *
+		 * @param buf Data to send
+		 * @param len Size (in bytes) of the data to send
+		 * @param flags Sending flags (unused, kept for parity with Socket::Send())
+		 */
+		void Send(const char *buf, int len, int flags);
+		/**
+		 * @brief Receive data from the peer
+		 *
+		 * @param buf Destination to store data
+		 * @param len Size (in bytes) of the data received
+		 * @param flags Receiving flags (unused, kept for parity with Socket::Receive())
+		 * @return Data size in bytes. Less than len if the peer closed the ring or nonblocking mode is on
+		 */
+		int Receive(char *buf, int len, int flags);
+
+		/**
+		 * @brief Return the descriptor that becomes readable when the peer wakes this side up
+		 *
+		 * @return eventfd for incoming data
+		 */
+		int GetNotifyHandle() const;
+
+		/**
+		 * @brief Arm the incoming data notification before going to sleep in an event loop
+		 *
+		 * @return True if data arrived while arming, in which case the caller should not sleep
+		 */
+		bool ArmReadNotify();
+		/**
+		 * @brief Disarm the incoming data notification and clear any pending wakeup
+		 */
+		void DisarmReadNotify();
+	};
+}
+#endif // __linux__
+
+#endif // __SHARED_RING_H
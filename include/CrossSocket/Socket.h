@@ -3,18 +3,156 @@
 #define __SOCKET_H
 
 #include "CrossSocketUtils.h"
+#include "Message.h"
+#include "RateLimiter.h"
+
+#include <deque>
 
 namespace CrossSocket
 {
+	/**
+	 * @brief Kernel software timestamp of a send, reported once the data has left the network stack
+	 */
+	struct SendTimestamp
+	{
+		uint32_t id;          // For streams, the byte count (since timestamps were enabled) of the last byte sent. For datagrams, the datagram count
+		uint64_t nanoseconds; // Nanoseconds since the Unix epoch (CLOCK_REALTIME)
+	};
+
 	class Socket
 	{
 	private:
 		socket_t mSocket;
 
+		// Per-tick receive limits set by the SocketManager while it runs this Socket's onRead callback (-1 for no limit)
+		int mReadBudget = -1;
+		int mByteBudget = -1;
+		bool mBudgetExhausted = false;
+
+		/**
+		 * @brief Charge one read against the receive budget
+		 *
+		 * @param len Requested read size. Reduced to the remaining byte budget when capLength is true
+		 * @param capLength True to shorten the read to fit the byte budget (streams). False to leave it whole (datagrams)
+		 * @return True if the read may go ahead. False if the budget for this tick or the receive limit is used up
+		 */
+		bool TakeReadBudget(int &len, bool capLength);
+
+		// Library-owned buffers for length-prefixed messages. Their storage is reused, so steady-state messaging does not allocate
+		ByteBuffer mSendBuffer;
+		ByteBuffer mReceiveBuffer;
+		size_t mReceivedMessage = 0; // Size of the frame handed out by the last ReceiveMessage(), consumed on the next call
+		static constexpr size_t NoMessage = static_cast<size_t>(-1);
+		size_t mOpenMessage = NoMessage; // Stream offset in mSendBuffer of the message between BeginMessage() and SendMessage()
+
+		/**
+		 * @brief Return the bytes at the front of the send buffer that belong to finished messages or plain sends
+		 *
+		 * @return Size in bytes. Everything from an open message onwards is held back until SendMessage()
+		 */
+		size_t FinishedSendBytes() const;
+		bool mPeerClosed = false;
+
+		/**
+		 * @brief Output waiting to be sent in order. Either a shared payload, or a range of mSendBuffer that stays where it is
+		 */
+		struct QueuedPayload
+		{
+			SharedPayload payload; // Null for a range of mSendBuffer
+			size_t offset;		   // Bytes of the payload sent already
+			size_t end;			   // For a range of mSendBuffer, the stream offset it ends at. It starts where the previous range ended
+			bool broadcast;		   // Queued by SocketManager::Broadcast(), so a lag policy may drop it. Unicast output is never dropped
+		};
+
+		// Output queued by reference ahead of mSendBuffer. While it is not empty, finished messages are queued as ranges to keep their order
+		std::deque<QueuedPayload> mSendQueue;
+		size_t mQueuedBytes = 0;	 // Unsent bytes of shared payloads. Ranges of mSendBuffer are counted by FinishedSendBytes()
+		size_t mQueuedBufferEnd = 0; // Stream offset in mSendBuffer up to which ranges have been queued
+
+		/**
+		 * @brief Queue a reference to a payload behind everything already waiting to be sent
+		 *
+		 * @param payload Payload to queue
+		 * @param broadcast True if the payload comes from SocketManager::Broadcast()
+		 */
+		void QueuePayload(const SharedPayload &payload, bool broadcast);
+		/**
+		 * @brief Drop every queued broadcast payload that has not started sending. The Socket's own messages are kept
+		 *
+		 * @return Number of payloads dropped
+		 */
+		size_t DropUnsentPayloads();
+		/**
+		 * @brief Queue the finished messages in the send buffer that are not queued yet, as a range that references the buffer.
+		 * Nothing is copied, and an open message stays out of the queue
+		 */
+		void MoveSendBufferToQueue();
+
+		TokenBucket mSendLimit;
+		TokenBucket mReceiveLimit;
+		uint64_t mBytesSent = 0;
+		uint64_t mBytesReceived = 0;
+		uint64_t mSendThrottled = 0;
+		uint64_t mReceiveThrottled = 0;
+		bool mSendHeld = false;	   // The send limit is holding output back, and the hold is already counted
+		bool mReceiveHeld = false; // The receive limit refused the last read, so the hold it started is already counted
+
+		/**
+		 * @brief Charge received bytes against the per-tick budget and the receive limit
+		 *
+		 * @param received Number of bytes received
+		 */
+		void ChargeReceived(int received);
+		/**
+		 * @brief Send queued output, stopping at the send limit or an extra byte limit
+		 *
+		 * @param flags Sending flags
+		 * @param limit Most bytes to send, on top of the Socket's own send limit
+		 * @param sent Set to the number of bytes sent
+		 * @param error Set to the error code if sending failed, otherwise 0. The Socket is left open for the caller to deal with
+		 * @return True if all queued output has been sent
+		 */
+		bool FlushUpTo(int flags, uint64_t limit, uint64_t &sent, int &error);
+		/**
+		 * @brief Return how long until the send limit allows another packet
+		 *
+		 * @return Time in milliseconds (0 if a packet may be sent now)
+		 */
+		int MillisUntilSendAllowed();
+		/**
+		 * @brief Return how long until the receive limit allows another packet
+		 *
+		 * @return Time in milliseconds (0 if a packet may be received now)
+		 */
+		int MillisUntilReceiveAllowed();
+
+		// Kernel timestamps. Times are nanoseconds since the Unix epoch, 0 when the kernel gave none
+		bool mReceiveTimestamps = false;
+		bool mSendTimestamps = false;
+		uint64_t mReceiveTimestamp = 0; // Arrival of the data returned by the current or last Receive() call
+		uint64_t mFirstArrival = 0;     // Earliest arrival seen since the SocketManager last cleared it
+		std::deque<SendTimestamp> mSendCompletions;
+
+		/**
+		 * @brief Make one receive call, collecting the arrival timestamp when timestamps are enabled
+		 *
+		 * @param buf Destination to store data
+		 * @param len Size (in bytes) of the buffer
+		 * @param flags Receiving flags
+		 * @param from Source address (nullptr for connected Sockets)
+		 * @param fromlen Size (in bytes) of the source address
+		 * @return Data size in bytes, or SOCKET_ERROR
+		 */
+		int ReceiveChunk(char *buf, int len, int flags, sockaddr *from, int *fromlen);
+		/**
+		 * @brief Move every send timestamp waiting in the kernel error queue into mSendCompletions
+		 */
+		void ReadSendTimestamps();
+
 		/**
 		 * @brief Send an error message, close the socket, shut down CrossSocket, and throw and exception
 		 *
-		 * @param message Error message
+		 * @param message Error message. Must be a string literal, since its address keys log rate limiting
 		 * @param errorCode Error code
 		 */
 		void Error(const char *message, int errorCode);
@@ -30,6 +168,14 @@ namespace CrossSocket
 		 * @param existingSocket Socket to wrap
 		 */
 		explicit Socket(socket_t existingSocket);
+		/**
+		 * @brief Create a new Socket object with a specific address family and type
+		 *
+		 * @param family Address family (AF_INET, AF_INET6, AF_UNIX, ...)
+		 * @param type Socket type (SOCK_STREAM, SOCK_DGRAM, ...)
+		 * @param protocol Protocol (if no value passed, 0)
+		 */
+		Socket(int family, int type, int protocol = 0);
 		/**
 		 * @brief Socket destructor
 		 */
@@ -54,20 +200,58 @@ namespace CrossSocket
 		 */
 		void SetNonblockingMode(bool enable);
 
+		/**
+		 * @brief Let the kernel busy-poll the device queue on blocking receives and select() instead of waiting for an interrupt (Linux only)
+		 *
+		 * @param micros Time to busy-poll in microseconds. 0 disables busy polling
+		 * @param prefer Also set SO_PREFER_BUSY_POLL so the kernel defers interrupts while the application polls
+		 * @return True if the options were applied. False if the platform does not support them or the caller lacks permission
+		 */
+		bool SetBusyPoll(int micros, bool prefer = false);
+
 		/**
 		 * @brief Connect a CLIENT Socket to a SERVER Socket
 		 *
-		 * @param family Address family, usually AF_INET (IPv4)
-		 * @param address IP Address of the server
+		 * @param family Address family: AF_INET (IPv4), AF_INET6 (IPv6), or AF_UNSPEC to accept either literal
+		 * @param address Numeric IP Address of the server. Use SocketManager::Resolve() for host names
 		 * @param port Port the Server Socket is on
 		 */
 		void ConnectTo(short family, const char *address, u_short port);
+		/**
+		 * @brief Connect a CLIENT Socket to an already resolved address
+		 *
+		 * @param address Address of the server, such as one returned by SocketManager::Resolve()
+		 * @param addrlen Size (in bytes) of the address
+		 */
+		void ConnectTo(const sockaddr *address, int addrlen);
 		/**
 		 * @brief Bind a SERVER Socket to a port
 		 *
 		 * @param port Port to bind to
 		 */
 		void BindTo(u_short port);
+		/**
+		 * @brief Bind a SERVER Socket to a port on every local address of a family
+		 *
+		 * @param family AF_INET (IPv4) or AF_INET6 (IPv6). The Socket must have been created with the same family
+		 * @param port Port to bind to
+		 * @param dualStack For AF_INET6, also accept IPv4 connections as IPv4-mapped addresses (if no value passed, true)
+		 */
+		void BindTo(short family, u_short port, bool dualStack = true);
+#ifndef _WIN32
+		/**
+		 * @brief Connect a CLIENT Socket to a SERVER Socket over a local (AF_UNIX) path
+		 *
+		 * @param path Filesystem path the Server Socket is bound to
+		 */
+		void ConnectToLocal(const char *path);
+		/**
+		 * @brief Bind a local (AF_UNIX) SERVER Socket to a filesystem path
+		 *
+		 * @param path Filesystem path to bind to. Any stale file at that path is removed first
+		 */
+		void BindToLocal(const char *path);
+#endif // _WIN32
 		/**
 		 * @brief Tell the SERVER Socket to listen for connections
 		 *
@@ -107,6 +291,8 @@ namespace CrossSocket
 		/**
 		 * @brief Send data through a UDP connection
 		 *
+		 * With a send limit set, a datagram the limit cannot cover yet is dropped and counted in GetRateStats().sendThrottled
+		 *
 		 * @param buf Data to send
 		 * @param len Size (in bytes) of the data to send
 		 * @param flags Sending flags
@@ -121,7 +307,7 @@ namespace CrossSocket
 		 * @param buf Destination to store data
 		 * @param len Size (in bytes) of the data received
 		 * @param flags Receiving flags
-		 * @return Data size in bytes
+		 * @return Data size in bytes, or SOCKET_ERROR if the read budget (see IsBudgetExhausted()) or the receive limit (see IsThrottled()) holds the read back. The connection is still open
 		 */
 		int Receive(char *buf, int len, int flags);
 		/**
@@ -132,9 +318,153 @@ namespace CrossSocket
 		 * @param flags Receiving flags
 		 * @param from Source address
 		 * @param fromlen Size (in bytes) of the source address
-		 * @return Data size in bytes
+		 * @return Data size in bytes, or SOCKET_ERROR if the read budget (see IsBudgetExhausted()) or the receive limit (see IsThrottled()) holds the read back. The connection is still open
 		 */
 		int Receive(char *buf, int len, int flags, sockaddr *from, int *fromlen);
+		/**
+		 * @brief Receive data through a TCP connection along with when the kernel received it
+		 *
+		 * @param buf Destination to store data
+		 * @param len Size (in bytes) of the data received
+		 * @param flags Receiving flags
+		 * @param timestamp Set to the kernel arrival time in nanoseconds since the Unix epoch (0 if timestamps are not enabled)
+		 * @return Data size in bytes, or SOCKET_ERROR if the read budget (see IsBudgetExhausted()) or the receive limit (see IsThrottled()) holds the read back. The connection is still open
+		 */
+		int Receive(char *buf, int len, int flags, uint64_t &timestamp);
+		/**
+		 * @brief Receive data through a UDP connection along with when the kernel received it
+		 *
+		 * @param buf Destination to store data
+		 * @param len Size (in bytes) of the data received
+		 * @param flags Receiving flags
+		 * @param from Source address
+		 * @param fromlen Size (in bytes) of the source address
+		 * @param timestamp Set to the kernel arrival time in nanoseconds since the Unix epoch (0 if timestamps are not enabled)
+		 * @return Data size in bytes, or SOCKET_ERROR if the read budget (see IsBudgetExhausted()) or the receive limit (see IsThrottled()) holds the read back. The connection is still open
+		 */
+		int Receive(char *buf, int len, int flags, sockaddr *from, int *fromlen, uint64_t &timestamp);
+		/**
+		 * @brief Check if the SocketManager's read budget stopped a receive in the current onRead callback
+		 *
+		 * The connection is still healthy. The SocketManager calls back again next tick to read the rest
+		 *
+		 * @return True if a Receive() or ReceiveMessage() call was refused for this tick
+		 */
+		bool IsBudgetExhausted() const;
+		/**
+		 * @brief Check if the receive limit (see SetReceiveRateLimit()) refused the last Receive() or ReceiveMessage() call
+		 *
+		 * The connection is still healthy. Reads go ahead again once the limit refills
+		 *
+		 * @return True while the receive limit is holding reads back
+		 */
+		bool IsThrottled() const;
+
+		/**
+		 * @brief Most send timestamps kept waiting for NextSendTimestamp(). Older ones are dropped first
+		 */
+		static constexpr size_t MaxSendTimestamps = 1024;
+
+		/**
+		 * @brief Turn kernel software timestamps on or off (SO_TIMESTAMPING, falling back to SO_TIMESTAMPNS for receive only. Linux only)
+		 *
+		 * Receive timestamps record when data reached the network stack, so the time it then spent queued in the kernel and in the
+		 * event loop can be measured. Send timestamps record when data left the stack and are read with NextSendTimestamp().
+		 * For TCP, enable send timestamps once the connection is established
+		 *
+		 * @param receive True to timestamp received data
+		 * @param send True to timestamp send completions
+		 * @return True if the kernel accepted the settings. False if it did not or the platform does not support them
+		 */
+		bool EnableTimestamps(bool receive, bool send = false);
+		/**
+		 * @brief Get the oldest send timestamp not yet returned
+		 *
+		 * @param completion Set to the send timestamp
+		 * @return True if a timestamp was returned. False if none are waiting
+		 */
+		bool NextSendTimestamp(SendTimestamp &completion);
+
+		/**
+		 * @brief Limit how fast queued output is sent. Bytes over the limit wait in the send queue for Flush() or the SocketManager
+		 *
+		 * Once a send limit is set, Send() queues whatever the limit does not allow yet instead of blocking
+		 *
+		 * @param bytesPerSecond Sustained rate. 0 removes the limit
+		 * @param burstBytes Largest burst allowed after an idle period. 0 picks 100 ms worth of the rate
+		 */
+		void SetSendRateLimit(uint64_t bytesPerSecond, uint64_t burstBytes = 0);
+		/**
+		 * @brief Limit how fast data is received. Once the limit runs dry, Receive() returns SOCKET_ERROR and IsThrottled() returns true until it refills
+		 *
+		 * @param bytesPerSecond Sustained rate. 0 removes the limit
+		 * @param burstBytes Largest burst allowed after an idle period. 0 picks 100 ms worth of the rate
+		 */
+		void SetReceiveRateLimit(uint64_t bytesPerSecond, uint64_t burstBytes = 0);
+		/**
+		 * @brief Ask the kernel to pace outgoing packets (SO_MAX_PACING_RATE, Linux only)
+		 *
+		 * @param bytesPerSecond Pacing rate. 0 removes the limit
+		 * @return True if the option was applied. False if the platform does not support it
+		 */
+		bool SetPacingRate(uint64_t bytesPerSecond);
+		/**
+		 * @brief Get the traffic counters and rate limits of the Socket
+		 *
+		 * @return Rate statistics
+		 */
+		RateStats GetRateStats() const;
+
+		/**
+		 * @brief Largest message ReceiveMessage() accepts, in bytes
+		 */
+		static constexpr uint32_t MaxMessageSize = 64 * 1024 * 1024;
+
+		/**
+		 * @brief Start a length-prefixed message in the Socket's send buffer
+		 *
+		 * Until SendMessage(), Flush() only sends what was queued before the message, so a half-written frame never goes out.
+		 * Only one message may be open at a time. Throws if one already is
+		 *
+		 * @return Writer that appends fields directly into the send buffer
+		 */
+		MessageWriter BeginMessage();
+		/**
+		 * @brief Finish a message from BeginMessage() and try to send everything queued
+		 *
+		 * @param message Writer returned by BeginMessage(). Only one message may be open at a time
+		 * @param flags Sending flags
+		 * @return True if the send buffer is now empty. False if a nonblocking Socket could not take all of it (call Flush() when writable)
+		 */
+		bool SendMessage(MessageWriter &message, int flags = 0);
+		/**
+		 * @brief Send as much of the queued output as the Socket will take
+		 *
+		 * @param flags Sending flags
+		 * @return True if the send buffer is now empty
+		 */
+		bool Flush(int flags = 0);
+		/**
+		 * @brief Return the number of bytes waiting to be sent, including queued shared payloads
+		 *
+		 * @return Size in bytes. A message still open from BeginMessage() is not counted
+		 */
+		size_t PendingSendBytes() const;
+
+		/**
+		 * @brief Receive the next length-prefixed message into the Socket's receive buffer
+		 *
+		 * @param message Set to a reader over the message. It reads straight from the receive buffer and is valid until the next call
+		 * @param flags Receiving flags
+		 * @return True if a whole message was received. False if a nonblocking Socket has no whole message yet, the read budget is used up, or the peer closed the connection
+		 */
+		bool ReceiveMessage(MessageReader &message, int flags = 0);
+		/**
+		 * @brief Check if ReceiveMessage() has seen the peer close the connection
+		 *
+		 * @return True if the connection is closed for reading
+		 */
+		bool IsPeerClosed() const;
 
 		/**
 		 * @brief Return the unwrapped socket
@@ -142,6 +472,8 @@ namespace CrossSocket
 		 * @return Socket in its lowest-level form
 		 */
 		socket_t GetRawSocket() const;
+
+		friend class SocketManager;
 	};
 }
 
@@ -2,12 +2,106 @@
 #define __SOCKET_MANAGER_H
 
 #include "Socket.h"
+#include "SharedRing.h"
+#include "Resolver.h"
+#include "RateLimiter.h"
 #include "CrossSocketUtils.h"
 
+#include <cstdint>
 #include <vector>
 
 namespace CrossSocket
 {
+    /**
+     * @brief Settings for the low-latency RunLoop() mode
+     */
+    struct LowLatencyConfig
+    {
+        int spinBudgetMicros = 50;    // How long to keep polling with a zero timeout after the last event before blocking
+        int minSpinBudgetMicros = 5;  // Floor the spin budget shrinks to while the loop stays idle
+        int idleTimeoutMillis = 1000; // Timeout of the blocking wait once spinning gives up
+        int busyPollMicros = 0;       // SO_BUSY_POLL applied to every watched Socket (0 leaves it unset)
+        bool preferBusyPoll = false;  // SO_PREFER_BUSY_POLL applied to every watched Socket
+    };
+
+    /**
+     * @brief Limits on how much work one Socket may do in a single RunOnce() tick
+     */
+    struct DispatchPolicy
+    {
+        int readsPerTick = 0;    // Socket::Receive() calls allowed per onRead callback (0 for no limit)
+        int bytesPerTick = 0;    // Bytes Socket::Receive() may return per onRead callback (0 for no limit)
+        bool roundRobin = false; // Rotate which Socket is dispatched first every tick
+    };
+
+    /**
+     * @brief What Broadcast() does with a subscriber that already has more than its limit waiting to be sent
+     */
+    enum class LagPolicy
+    {
+        Drop,      // Skip the new payload for this subscriber
+        Coalesce,  // Replace everything still waiting with the new payload, so the subscriber only gets the latest
+        Disconnect // Close the subscriber and remove it from the SocketManager
+    };
+
+    /**
+     * @brief Counters describing what Broadcast() has done
+     */
+    struct BroadcastStats
+    {
+        uint64_t queued;       // Payload references queued on subscribers
+        uint64_t dropped;      // Payloads skipped under LagPolicy::Drop
+        uint64_t coalesced;    // Waiting payloads replaced under LagPolicy::Coalesce
+        uint64_t disconnected; // Subscribers closed under LagPolicy::Disconnect or after a send error
+    };
+
+    /**
+     * @brief Counters describing how the event loop has been waking up
+     */
+    struct LoopStats
+    {
+        uint64_t spinPolls;       // Zero-timeout polls made while spinning
+        uint64_t spinHits;        // Spinning polls that found at least one event
+        uint64_t blockingWaits;   // Times the loop fell back to a blocking wait
+        uint64_t blockingWakeups; // Blocking waits that returned with at least one event
+        uint64_t budgetStops;     // onRead callbacks that ran out of their dispatch budget
+
+        /**
+         * @brief Fraction of event-bearing wakeups that were caught while spinning
+         *
+         * @return Value from 0 to 1. 0 if no events have been seen
+         */
+        double SpinHitRate() const
+        {
+            uint64_t total = spinHits + blockingWakeups;
+            return total == 0 ? 0.0 : static_cast<double>(spinHits) / static_cast<double>(total);
+        }
+    };
+
+    /**
+     * @brief Timeline of one onRead callback for a Socket with receive timestamps enabled
+     *
+     * All times are nanoseconds since the Unix epoch (CLOCK_REALTIME), the clock the kernel timestamps use
+     */
+    struct EventLatency
+    {
+        int id;                 // Socket ID
+        uint64_t arrival;       // When the kernel received the earliest data the callback read
+        uint64_t wakeup;        // When select() returned
+        uint64_t callbackStart; // When the onRead callback started
+        uint64_t callbackEnd;   // When the onRead callback returned
+
+        /**
+         * @brief Time the data waited between reaching the kernel and the callback starting
+         *
+         * @return Delay in nanoseconds
+         */
+        uint64_t ArrivalToCallback() const
+        {
+            return callbackStart > arrival ? callbackStart - arrival : 0;
+        }
+    };
+
     class SocketManager
     {
     public:
@@ -34,12 +128,80 @@ namespace CrossSocket
          */
         int AddSocket(Socket &socket, bool monitorRead, bool monitorWrite, void (*onRead)(Socket &) = nullptr, void (*onWrite)(Socket &) = nullptr);
 
+#ifdef __linux__
+        /**
+         * @brief Add a SharedRing to the SocketManager event loop
+         *
+         * @param ring Connected SharedRing to add
+         * @param onRead Function pointer to callback upon data receiving (must take SharedRing& as only parameter)
+         * @return SharedRing ID in vector
+         */
+        int AddSharedRing(SharedRing &ring, void (*onRead)(SharedRing &));
+
+        /**
+         * @brief Remove a SharedRing from the event loop
+         *
+         * @param id SharedRing ID to remove
+         */
+        void CloseSharedRing(int id);
+
+        /**
+         * @brief Relay data between two connected Sockets in both directions without copying it through user space
+         *
+         * Data moves kernel-side with splice() through one pipe per direction. A side is only read while its pipe has room,
+         * so a slow receiver holds back its sender. When one side finishes sending, the other side is shut down for sending
+         * once everything has been flushed. Both Sockets are switched to nonblocking mode and must not also be added with AddSocket()
+         *
+         * @param first First Socket
+         * @param second Second Socket
+         * @param onClosed Function pointer to callback once both directions have finished or failed (must take Socket&, Socket&). The relay is already removed when it runs
+         * @return Relay ID in vector
+         */
+        int AddRelay(Socket &first, Socket &second, void (*onClosed)(Socket &, Socket &) = nullptr);
+
+        /**
+         * @brief Remove a relay from the event loop and close both of its Sockets
+         *
+         * @param id Relay ID to remove
+         */
+        void CloseRelay(int id);
+
+        /**
+         * @brief Get the number of bytes a relay has delivered in each direction
+         *
+         * @param id Relay ID
+         * @param firstToSecond Bytes delivered from the first Socket to the second
+         * @param secondToFirst Bytes delivered from the second Socket to the first
+         */
+        void GetRelayBytes(int id, uint64_t &firstToSecond, uint64_t &secondToFirst) const;
+#endif // __linux__
+
+        /**
+         * @brief Resolve a host name without blocking the event loop. The callback runs from a later RunOnce()
+         *
+         * @param host Host name or numeric address (names in the local hosts file are honored)
+         * @param port Port to store in every returned address
+         * @param family AF_INET, AF_INET6, or AF_UNSPEC for both
+         * @param onResolved Function pointer to callback with the result (must take const Resolution& and void*)
+         * @param userData Pointer passed back to the callback untouched
+         */
+        void Resolve(const char *host, u_short port, int family, Resolver::Callback onResolved, void *userData = nullptr);
+
+        /**
+         * @brief Set how long name lookups stay cached
+         *
+         * @param ttlMillis Time for successful lookups in milliseconds. 0 disables caching
+         * @param negativeTtlMillis Time for failed lookups in milliseconds. 0 disables caching
+         */
+        void SetResolverCacheTTL(int ttlMillis, int negativeTtlMillis = Resolver::DefaultNegativeCacheTTL);
+
         /**
          * @brief Check all watched Sockets for updates
          *
          * @param timeoutMillis Timeout for check in milliseconds
+         * @return Number of callbacks run
          */
-        void RunOnce(int timeoutMillis = 1000);
+        int RunOnce(int timeoutMillis = 1000);
 
         /**
          * @brief Continuously check all watched Sockets for updates
@@ -48,6 +210,118 @@ namespace CrossSocket
          */
         void RunLoop(bool *condition = nullptr);
 
+        /**
+         * @brief Set how RunOnce() shares each tick between Sockets
+         *
+         * When a Socket's budget runs out, Socket::Receive() returns SOCKET_ERROR and Socket::IsBudgetExhausted() returns true, so it is never mistaken for the peer closing.
+         * The remaining data stays queued in the kernel and the Socket is called back on the next tick
+         *
+         * @param policy Per-tick receive budgets and round-robin setting
+         */
+        void SetDispatchPolicy(const DispatchPolicy &policy);
+
+        /**
+         * @brief Mark a Socket as control-plane. Control-plane Sockets are dispatched first every tick and are not limited by the dispatch budgets
+         *
+         * @param id Socket ID
+         * @param priority True for control-plane. False for the normal class
+         */
+        void SetSocketPriority(int id, bool priority);
+
+        /**
+         * @brief Make a watched Socket a broadcast subscriber. The Socket is switched to nonblocking mode
+         *
+         * @param id Socket ID
+         * @param policy What to do once more than maxQueuedBytes are waiting to be sent
+         * @param maxQueuedBytes Bytes allowed to wait before the lag policy applies
+         */
+        void SetSubscriber(int id, LagPolicy policy, size_t maxQueuedBytes);
+
+        /**
+         * @brief Queue one payload on every subscriber without copying it
+         *
+         * Each subscriber holds a reference to the payload until it has been sent, and the payload is freed after the last one.
+         * Output that does not go out immediately is flushed by RunOnce() when the subscriber becomes writable
+         *
+         * @param payload Payload to send
+         * @return Number of subscribers the payload was queued on
+         */
+        int Broadcast(const SharedPayload &payload);
+        /**
+         * @brief Queue one payload on specific subscribers without copying it
+         *
+         * @param payload Payload to send
+         * @param ids IDs of the subscribers to send to
+         * @return Number of subscribers the payload was queued on
+         */
+        int Broadcast(const SharedPayload &payload, const std::vector<int> &ids);
+
+        /**
+         * @brief Get counters describing what Broadcast() has done
+         *
+         * @return Broadcast statistics
+         */
+        BroadcastStats GetBroadcastStats() const;
+
+        /**
+         * @brief Limit how fast queued output is sent across all Sockets, on top of each Socket's own limit. Control-plane Sockets are exempt
+         *
+         * Sockets are only waited on for writing while the limit allows another packet, so a throttled loop sleeps instead of spinning
+         *
+         * @param bytesPerSecond Sustained rate. 0 removes the limit
+         * @param burstBytes Largest burst allowed after an idle period. 0 picks 100 ms worth of the rate
+         */
+        void SetSendRateLimit(uint64_t bytesPerSecond, uint64_t burstBytes = 0);
+
+        /**
+         * @brief Limit how fast data is received across all Sockets, on top of each Socket's own limit. Control-plane Sockets are exempt
+         *
+         * Sockets are only waited on for reading while the limit allows another packet. Unread data stays queued in the kernel,
+         * so TCP flow control slows the sender down
+         *
+         * @param bytesPerSecond Sustained rate. 0 removes the limit
+         * @param burstBytes Largest burst allowed after an idle period. 0 picks 100 ms worth of the rate
+         */
+        void SetReceiveRateLimit(uint64_t bytesPerSecond, uint64_t burstBytes = 0);
+
+        /**
+         * @brief Get the traffic the event loop has moved and how often the SocketManager limits held it back
+         *
+         * Per-Socket counters are available from Socket::GetRateStats()
+         *
+         * @return Rate statistics
+         */
+        RateStats GetRateStats() const;
+
+        /**
+         * @brief Report the arrival-to-callback timeline of every onRead callback that read timestamped data
+         *
+         * Only Sockets with Socket::EnableTimestamps() receive timestamps produce reports. The observer runs right after the callback
+         *
+         * @param onLatency Function pointer to call with each report (must take const EventLatency&). nullptr stops reporting
+         */
+        void SetLatencyObserver(void (*onLatency)(const EventLatency &));
+
+        /**
+         * @brief Switch RunLoop() between blocking waits (default) and spinning with zero-timeout polls before blocking
+         *
+         * @param enable True to spin before blocking. False to always block in RunOnce()
+         * @param config Spin budget, idle timeout, and busy-poll settings. Busy polling is turned back off when the new mode does not use it
+         */
+        void SetLowLatencyMode(bool enable, const LowLatencyConfig &config = LowLatencyConfig());
+
+        /**
+         * @brief Get counters describing how the event loop has been waking up
+         *
+         * @return Loop statistics since the last ResetLoopStats()
+         */
+        LoopStats GetLoopStats() const;
+
+        /**
+         * @brief Reset the loop statistics to zero
+         */
+        void ResetLoopStats();
+
         /**
          * @brief Remove a socket from the event loop
          *
@@ -80,9 +354,122 @@ namespace CrossSocket
             bool monitorWrite;
             void (*onRead)(Socket &);
             void (*onWrite)(Socket &);
+            bool priority;
+            bool subscriber;
+            LagPolicy lagPolicy;
+            size_t maxQueuedBytes;
+            bool failed; // Set when flushing queued output failed. Removed at the end of the tick
+            bool sendHeld;    // The SocketManager send limit is holding this Socket's output back. Throttling is counted when this turns on
+            bool receiveHeld; // The SocketManager receive limit is keeping this Socket out of select()
         };
 
+        BroadcastStats broadcastStats;
+
+        TokenBucket sendLimit;
+        TokenBucket receiveLimit;
+        RateStats rateStats;
+
+        /**
+         * @brief Flush queued output as far as the rate limits allow, without letting a broken connection escape the event loop
+         *
+         * @param ws Watched Socket to flush
+         * @return False if the Socket failed and was closed
+         */
+        bool FlushOutput(WatchedSocket &ws);
+
         std::vector<WatchedSocket> sockets;
+
+        DispatchPolicy dispatchPolicy;
+        size_t dispatchStart; // Index the normal class starts from on the next tick
+
+        struct DispatchEntry
+        {
+            Socket *socket;
+            size_t index; // Index when the tick started. Sockets closed by callbacks can only move it lower
+        };
+
+        std::vector<DispatchEntry> dispatchOrder; // Reused every tick so dispatching does not allocate
+
+        /**
+         * @brief Run the callbacks of one watched Socket, applying the per-tick receive budget
+         *
+         * @param ws Watched Socket
+         * @param readSet Sockets select() reported as readable
+         * @param writeSet Sockets select() reported as writable
+         * @return Number of callbacks run
+         */
+        int DispatchSocket(WatchedSocket &ws, fd_set &readSet, fd_set &writeSet);
+
+        void (*latencyObserver)(const EventLatency &);
+        uint64_t wakeupTime; // When select() last returned, only tracked while a latency observer is set
+
+        bool lowLatency;
+        LowLatencyConfig lowLatencyConfig;
+        int spinBudgetMicros; // Current spin budget, shrinks while idle and resets on events
+        LoopStats loopStats;
+
+        /**
+         * @brief Spin with zero-timeout polls until the spin budget runs out, then block once
+         *
+         * @param condition RunLoop() condition, checked between polls
+         */
+        void RunLowLatencyCycle(bool *condition);
+
+        Resolver resolver;
+
+#ifdef __linux__
+        struct WatchedRing
+        {
+            SharedRing *ring;
+            int id;
+            void (*onRead)(SharedRing &);
+        };
+
+        std::vector<WatchedRing> rings;
+        std::vector<SharedRing *> ringOrder; // Rings watched when the tick started, reused so dispatching does not allocate
+
+        struct RelayDirection
+        {
+            Socket *from;
+            Socket *to;
+            int pipeRead;
+            int pipeWrite;
+            size_t buffered; // Bytes sitting in the pipe
+            bool pipeFull;   // The pipe refused more data before buffered reached its capacity (it fills by pages, not bytes)
+            bool eof;
+            bool shutdownSent;
+            uint64_t bytes;
+        };
+
+        struct WatchedRelay
+        {
+            int id;
+            RelayDirection directions[2];
+            size_t pipeCapacity;
+            bool failed;
+            void (*onClosed)(Socket &, Socket &);
+        };
+
+        std::vector<WatchedRelay> relays;
+
+        /**
+         * @brief Move data through one direction of a relay
+         *
+         * @param direction Direction to move
+         * @param pipeCapacity Size (in bytes) of the direction's pipe
+         * @param readable True if select() reported the source as readable
+         * @param failed Set to true if either Socket failed
+         * @return True if any data moved or the direction changed state. False if nothing happened or an error occurred
+         */
+        bool PumpRelay(RelayDirection &direction, size_t pipeCapacity, bool readable, bool &failed);
+
+        /**
+         * @brief Close the pipes of a relay
+         *
+         * @param relay Relay to release
+         */
+        static void ReleaseRelay(WatchedRelay &relay);
+#endif // __linux__
     };
 }
 
@@ -0,0 +1,10 @@
+#include "CrossSocket/BasicSocketManager.h"
+
+namespace CrossSocket
+{
+	// Explicit instantiations, so a template error shows up when the library is built rather than in a program using it
+	template class BasicSocket<DefaultBackend, ThrowOnError>;
+	template class BasicSocket<DefaultBackend, ReturnErrorCode>;
+	template class BasicSocketManager<BasicSocket<DefaultBackend, ThrowOnError>>;
+	template class BasicSocketManager<BasicSocket<DefaultBackend, ReturnErrorCode>>;
+}
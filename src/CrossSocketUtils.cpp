@@ -1,7 +1,15 @@
 #include "CrossSocket/CrossSocketUtils.h"
 
+#include <cstring>
 #include <stdexcept>
 
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
 namespace CrossSocket
 {
 	bool CS_Utils::initialized = false;
@@ -41,25 +49,195 @@ namespace CrossSocket
 		initialized = false;
 	}
 
+	namespace
+	{
+		using SwapKernel = void (*)(const uint8_t *src, uint8_t *dst, size_t bytes, size_t width);
+
+		/**
+		 * @brief Reverse every width-byte element one at a time
+		 */
+		void SwapScalar(const uint8_t *src, uint8_t *dst, size_t bytes, size_t width)
+		{
+			for (size_t i = 0; i < bytes; i += width)
+			{
+				if (width == 2)
+				{
+					uint16_t v;
+					std::memcpy(&v, src + i, 2);
+					v = CS_Utils::cs_bswap16(v);
+					std::memcpy(dst + i, &v, 2);
+				}
+				else if (width == 4)
+				{
+					uint32_t v;
+					std::memcpy(&v, src + i, 4);
+					v = CS_Utils::cs_bswap32(v);
+					std::memcpy(dst + i, &v, 4);
+				}
+				else
+				{
+					uint64_t v;
+					std::memcpy(&v, src + i, 8);
+					v = CS_Utils::cs_bswap64(v);
+					std::memcpy(dst + i, &v, 8);
+				}
+			}
+		}
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define CS_X86_SIMD 1
+#if defined(__GNUC__) || defined(__clang__)
+#define CS_TARGET(isa) __attribute__((target(isa)))
+#else
+#define CS_TARGET(isa)
+#endif
+
+		// pshufb masks that reverse each 2, 4, or 8-byte lane of a 16-byte block
+		alignas(16) const uint8_t ShuffleMasks[3][16] = {
+			{1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14},
+			{3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12},
+			{7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8},
+		};
+
+		inline const uint8_t *MaskFor(size_t width)
+		{
+			return ShuffleMasks[width == 2 ? 0 : width == 4 ? 1 : 2];
+		}
+
+		/**
+		 * @brief Reverse elements 16 bytes at a time with SSSE3
+		 */
+		CS_TARGET("ssse3")
+		void SwapSSSE3(const uint8_t *src, uint8_t *dst, size_t bytes, size_t width)
+		{
+			const __m128i mask = _mm_load_si128(reinterpret_cast<const __m128i *>(MaskFor(width)));
+			size_t i = 0;
+			for (; i + 16 <= bytes; i += 16)
+			{
+				__m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i));
+				_mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), _mm_shuffle_epi8(v, mask));
+			}
+			SwapScalar(src + i, dst + i, bytes - i, width);
+		}
+
+		/**
+		 * @brief Reverse elements 64 bytes at a time with AVX2, finishing with SSSE3
+		 */
+		CS_TARGET("avx2")
+		void SwapAVX2(const uint8_t *src, uint8_t *dst, size_t bytes, size_t width)
+		{
+			const __m256i mask = _mm256_broadcastsi128_si256(_mm_load_si128(reinterpret_cast<const __m128i *>(MaskFor(width))));
+			size_t i = 0;
+			for (; i + 64 <= bytes; i += 64)
+			{
+				__m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + i));
+				__m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + i + 32));
+				_mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i), _mm256_shuffle_epi8(a, mask));
+				_mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i + 32), _mm256_shuffle_epi8(b, mask));
+			}
+			SwapSSSE3(src + i, dst + i, bytes - i, width);
+		}
+
+		/**
+		 * @brief Pick the widest kernel the CPU supports
+		 */
+		SwapKernel DetectKernel()
+		{
+#if defined(__GNUC__) || defined(__clang__)
+			__builtin_cpu_init();
+			if (__builtin_cpu_supports("avx2"))
+			{
+				return SwapAVX2;
+			}
+			if (__builtin_cpu_supports("ssse3"))
+			{
+				return SwapSSSE3;
+			}
+#else
+			int info[4];
+			__cpuid(info, 0);
+			int maxLeaf = info[0];
+			__cpuid(info, 1);
+			bool ssse3 = (info[2] & (1 << 9)) != 0;
+			bool osxsave = (info[2] & (1 << 27)) != 0;
+			if (maxLeaf >= 7 && osxsave && (_xgetbv(0) & 0x6) == 0x6) // The OS must save YMM state for AVX2 to be usable
+			{
+				__cpuidex(info, 7, 0);
+				if (info[1] & (1 << 5))
+				{
+					return SwapAVX2;
+				}
+			}
+			if (ssse3)
+			{
+				return SwapSSSE3;
+			}
+#endif
+			return SwapScalar;
+		}
+#endif // x86
+
+		/**
+		 * @brief Convert width-byte elements between host and network byte order
+		 */
+		void ConvertArray(const void *src, void *dst, size_t count, size_t width)
+		{
+#if CS_LITTLE_ENDIAN
+#ifdef CS_X86_SIMD
+			static const SwapKernel kernel = DetectKernel();
+#else
+			static const SwapKernel kernel = SwapScalar; // Compilers vectorize this loop on their own for other targets
+#endif
+			kernel(static_cast<const uint8_t *>(src), static_cast<uint8_t *>(dst), count * width, width);
+#else
+			if (src != dst) // Network order is already host order
+			{
+				std::memmove(dst, src, count * width);
+			}
+#endif // CS_LITTLE_ENDIAN
+		}
+	}
+
 	/**
-	 * @brief Convert to network byte order (to big-endian)
+	 * @brief Convert an array to network byte order in place. Uses SSSE3/AVX2 when the CPU supports them
 	 *
-	 * @param val Value to convert
-	 * @return Input value in big-endian
+	 * @param values Values to convert
+	 * @param count Number of values
 	 */
-	uint32_t CS_Utils::cs_htonl(uint32_t val)
+	void CS_Utils::cs_hton_array(uint16_t *values, size_t count)
+	{
+		ConvertArray(values, values, count, sizeof(uint16_t));
+	}
+
+	void CS_Utils::cs_hton_array(uint32_t *values, size_t count)
+	{
+		ConvertArray(values, values, count, sizeof(uint32_t));
+	}
+
+	void CS_Utils::cs_hton_array(uint64_t *values, size_t count)
 	{
-		return htonl(val);
+		ConvertArray(values, values, count, sizeof(uint64_t));
 	}
 
 	/**
-	 * @brief Convert from network byte order (to little-endian)
+	 * @brief Convert an array to network byte order into another array. Uses SSSE3/AVX2 when the CPU supports them
 	 *
-	 * @param val Value to convert
-	 * @return Input value in little-endian
+	 * @param src Values to convert
+	 * @param dst Destination for the converted values. May be the same as src, but must not partially overlap it
+	 * @param count Number of values
 	 */
-	uint32_t CS_Utils::cs_ntohl(uint32_t val)
+	void CS_Utils::cs_hton_array(const uint16_t *src, uint16_t *dst, size_t count)
+	{
+		ConvertArray(src, dst, count, sizeof(uint16_t));
+	}
+
+	void CS_Utils::cs_hton_array(const uint32_t *src, uint32_t *dst, size_t count)
+	{
+		ConvertArray(src, dst, count, sizeof(uint32_t));
+	}
+
+	void CS_Utils::cs_hton_array(const uint64_t *src, uint64_t *dst, size_t count)
 	{
-		return ntohl(val);
+		ConvertArray(src, dst, count, sizeof(uint64_t));
 	}
 }
@@ -0,0 +1,336 @@
+#include "CrossSocket/Log.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace CrossSocket
+{
+	namespace
+	{
+		/**
+		 * @brief Single-producer/single-consumer ring owned by one logging thread and drained by whoever holds the drain lock
+		 */
+		struct ThreadRing
+		{
+			LogRecord records[Log::RingRecords];
+			std::atomic<uint64_t> head{0}; // Next record the owning thread writes
+			std::atomic<uint64_t> tail{0}; // Next record the drain reads
+			std::atomic<bool> abandoned{false};
+
+			// Rate limiting state, only touched by the owning thread
+			struct Repeat
+			{
+				const void *site;
+				uint64_t windowStart;
+				uint32_t count;
+				uint32_t suppressed;
+			};
+			static constexpr size_t RepeatSlots = 32;
+			Repeat repeats[RepeatSlots] = {};
+		};
+
+		struct Logger
+		{
+			std::mutex ringsMutex; // Guards rings. Only taken when a thread logs for the first time and while draining
+			std::vector<ThreadRing *> rings;
+
+			std::mutex drainMutex; // Held while draining, so each ring has a single consumer
+			Log::Sink sink = Log::StderrSink;
+			void *userData = nullptr;
+
+			std::atomic<uint64_t> dropped{0};
+
+			std::mutex threadMutex;
+			std::condition_variable wake;
+			std::thread drainThread;
+			bool stopping = false;
+
+			~Logger()
+			{
+				{
+					std::lock_guard<std::mutex> lock(threadMutex);
+					stopping = true;
+				}
+				wake.notify_all();
+				if (drainThread.joinable())
+				{
+					drainThread.join();
+				}
+				Drain();
+				for (ThreadRing *ring : rings)
+				{
+					delete ring;
+				}
+			}
+
+			/**
+			 * @brief Drain thread body. Polls on an interval so writers never have to wake it
+			 */
+			void Run()
+			{
+				std::unique_lock<std::mutex> lock(threadMutex);
+				while (!stopping)
+				{
+					lock.unlock();
+					Drain();
+					lock.lock();
+					wake.wait_for(lock, std::chrono::milliseconds(10), [this]()
+								  { return stopping; });
+				}
+			}
+
+			/**
+			 * @brief Format every queued record and pass it to the sink. Rings of threads that have exited are freed once empty
+			 */
+			void Drain()
+			{
+				std::lock_guard<std::mutex> drainLock(drainMutex);
+				std::vector<ThreadRing *> current;
+				{
+					std::lock_guard<std::mutex> lock(ringsMutex);
+					current = rings;
+				}
+
+				for (ThreadRing *ring : current)
+				{
+					bool abandoned = ring->abandoned.load(std::memory_order_acquire); // Read before draining so nothing written after it is missed
+					uint64_t head = ring->head.load(std::memory_order_acquire);
+					uint64_t tail = ring->tail.load(std::memory_order_relaxed);
+					for (; tail != head; ++tail)
+					{
+						const LogRecord &record = ring->records[tail % Log::RingRecords];
+						char text[512];
+						Format(record, text, sizeof(text));
+						sink(record.level, record.timestamp, text, userData);
+					}
+					ring->tail.store(tail, std::memory_order_release);
+
+					if (abandoned)
+					{
+						std::lock_guard<std::mutex> lock(ringsMutex);
+						for (size_t i = 0; i < rings.size(); ++i)
+						{
+							if (rings[i] == ring)
+							{
+								rings.erase(rings.begin() + i);
+								break;
+							}
+						}
+						delete ring;
+					}
+				}
+			}
+
+			/**
+			 * @brief Turn a record into text, replacing each "{}" with the next argument
+			 *
+			 * @param record Record to format
+			 * @param out Destination for the text
+			 * @param size Size (in bytes) of the destination
+			 */
+			static void Format(const LogRecord &record, char *out, size_t size)
+			{
+				std::string text;
+				uint8_t arg = 0;
+				for (const char *c = record.format; *c != '\0'; ++c)
+				{
+					if (c[0] == '{' && c[1] == '}' && arg < record.count)
+					{
+						if (record.stringMask & (1u << arg))
+						{
+							text += record.text + record.args[arg];
+						}
+						else if (record.unsignedMask & (1u << arg))
+						{
+							text += std::to_string(static_cast<uint64_t>(record.args[arg]));
+						}
+						else
+						{
+							text += std::to_string(record.args[arg]);
+						}
+						++arg;
+						++c;
+					}
+					else
+					{
+						text += *c;
+					}
+				}
+				if (record.suppressed > 0)
+				{
+					text += " (" + std::to_string(record.suppressed) + " repeats suppressed)";
+				}
+				std::snprintf(out, size, "%s", text.c_str());
+			}
+		};
+
+		Logger &GetLogger()
+		{
+			static Logger logger;
+			return logger;
+		}
+
+		/**
+		 * @brief Marks the calling thread's ring as abandoned when the thread exits, so the drain can free it
+		 */
+		struct RingOwner
+		{
+			ThreadRing *ring = nullptr;
+
+			~RingOwner()
+			{
+				if (ring != nullptr)
+				{
+					for (const ThreadRing::Repeat &repeat : ring->repeats)
+					{
+						GetLogger().dropped.fetch_add(repeat.suppressed, std::memory_order_relaxed); // Repeats the thread never got to report
+					}
+					ring->abandoned.store(true, std::memory_order_release);
+				}
+			}
+		};
+
+		thread_local RingOwner tRing;
+
+		/**
+		 * @brief Give the calling thread a ring. Starts the drain thread on first use
+		 *
+		 * @return The thread's ring
+		 */
+		ThreadRing *RegisterThread()
+		{
+			Logger &logger = GetLogger();
+			ThreadRing *ring = new ThreadRing();
+			{
+				std::lock_guard<std::mutex> lock(logger.ringsMutex);
+				logger.rings.push_back(ring);
+			}
+			{
+				std::lock_guard<std::mutex> lock(logger.threadMutex);
+				if (!logger.drainThread.joinable() && !logger.stopping)
+				{
+					logger.drainThread = std::thread(&Logger::Run, &logger);
+				}
+			}
+			tRing.ring = ring;
+			return ring;
+		}
+	}
+
+	/**
+	 * @brief Stamp a record and copy it into the calling thread's ring
+	 *
+	 * @param record Record to queue
+	 */
+	void Log::Commit(LogRecord &record)
+	{
+		ThreadRing *ring = tRing.ring;
+		if (ring == nullptr)
+		{
+			ring = RegisterThread();
+		}
+
+		record.timestamp = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count());
+
+		// Rate limit per call site, keyed on the site token rather than the text.
+		// Each site may sit in one of two neighbouring slots, so two busy sites that hash alike do not keep evicting each other
+		uint64_t key = static_cast<uint64_t>(reinterpret_cast<uintptr_t>(record.site)) * 0x9E3779B97F4A7C15ull;
+		size_t slot = static_cast<size_t>(key >> 32) % ThreadRing::RepeatSlots;
+		ThreadRing::Repeat *repeat = &ring->repeats[slot];
+		ThreadRing::Repeat *neighbour = &ring->repeats[(slot + 1) % ThreadRing::RepeatSlots];
+		if (repeat->site != record.site)
+		{
+			if (neighbour->site == record.site)
+			{
+				repeat = neighbour;
+			}
+			else
+			{
+				if (neighbour->windowStart < repeat->windowStart)
+				{
+					repeat = neighbour; // Evict whichever was seen longer ago
+				}
+				if (repeat->suppressed > 0)
+				{
+					GetLogger().dropped.fetch_add(repeat->suppressed, std::memory_order_relaxed); // Evicted before it could be reported
+				}
+				*repeat = ThreadRing::Repeat{record.site, record.timestamp, 0, 0};
+			}
+		}
+		else if (record.timestamp - repeat->windowStart >= 1000000000ull)
+		{
+			repeat->windowStart = record.timestamp;
+			repeat->count = 0;
+		}
+		if (++repeat->count > RepeatLimit)
+		{
+			++repeat->suppressed;
+			return;
+		}
+		record.suppressed = repeat->suppressed;
+		repeat->suppressed = 0;
+
+		uint64_t head = ring->head.load(std::memory_order_relaxed);
+		if (head - ring->tail.load(std::memory_order_acquire) >= RingRecords)
+		{
+			GetLogger().dropped.fetch_add(1, std::memory_order_relaxed);
+			return;
+		}
+		std::memcpy(&ring->records[head % RingRecords], &record, sizeof(record));
+		ring->head.store(head + 1, std::memory_order_release);
+	}
+
+	/**
+	 * @brief Replace where formatted messages go. The default writes to stderr
+	 *
+	 * @param sink Function pointer to call with each message. nullptr restores the default
+	 * @param userData Pointer passed back to the sink untouched
+	 */
+	void Log::SetSink(Sink sink, void *userData)
+	{
+		Logger &logger = GetLogger();
+		std::lock_guard<std::mutex> lock(logger.drainMutex);
+		logger.sink = sink != nullptr ? sink : StderrSink;
+		logger.userData = userData;
+	}
+
+	/**
+	 * @brief Format and pass every queued record to the sink before returning
+	 */
+	void Log::Flush()
+	{
+		GetLogger().Drain();
+	}
+
+	/**
+	 * @brief Get the number of records dropped because a ring was full, plus rate-limited repeats that were never reported
+	 *
+	 * @return Dropped record count
+	 */
+	uint64_t Log::GetDropped()
+	{
+		return GetLogger().dropped.load(std::memory_order_relaxed);
+	}
+
+	/**
+	 * @brief Default sink. Writes "[CrossSocket] LEVEL message" lines to stderr
+	 *
+	 * @param level Severity
+	 * @param timestamp Nanoseconds since the Unix epoch
+	 * @param text Formatted message
+	 * @param userData Unused
+	 */
+	void Log::StderrSink(LogLevel level, uint64_t timestamp, const char *text, void *userData)
+	{
+		(void)timestamp;
+		(void)userData;
+		static const char *const names[] = {"DEBUG", "INFO", "WARNING", "ERROR"};
+		std::fprintf(stderr, "[CrossSocket] %s %s\n", names[static_cast<int>(level) & 3], text);
+	}
+}
@@ -0,0 +1,277 @@
+#include "CrossSocket/Message.h"
+
+#include <cstring>
+#include <stdexcept>
+
+namespace CrossSocket
+{
+	/**
+	 * @brief Make room for at least n more bytes without changing the data
+	 *
+	 * @param n Number of bytes
+	 * @return Pointer to the free space after the data
+	 */
+	char *ByteBuffer::Reserve(size_t n)
+	{
+		if (Available() >= n)
+		{
+			return mStorage.data() + mEnd;
+		}
+
+		// Slide the data to the front before growing. Consumed space is usually enough
+		size_t size = Size();
+		if (mBegin > 0)
+		{
+			std::memmove(mStorage.data(), mStorage.data() + mBegin, size);
+			mBegin = 0;
+			mEnd = size;
+		}
+		if (mStorage.size() - mEnd < n)
+		{
+			size_t capacity = mStorage.size() < 256 ? 256 : mStorage.size();
+			while (capacity - mEnd < n)
+			{
+				capacity *= 2;
+			}
+			mStorage.resize(capacity);
+		}
+		return mStorage.data() + mEnd;
+	}
+
+	/**
+	 * @brief Grow the data by n bytes, making room first if needed
+	 *
+	 * @param n Number of bytes
+	 * @return Pointer to the first of the new bytes
+	 */
+	char *ByteBuffer::Append(size_t n)
+	{
+		char *space = Reserve(n);
+		mEnd += n;
+		return space;
+	}
+
+	/**
+	 * @brief Remove bytes from the front of the data
+	 *
+	 * @param n Number of bytes
+	 */
+	void ByteBuffer::Consume(size_t n)
+	{
+		mConsumed += n;
+		mBegin += n;
+		if (mBegin >= mEnd)
+		{
+			mBegin = mEnd = 0; // Empty, so the next write starts at the front for free
+		}
+	}
+
+	/**
+	 * @brief Start writing at the end of a buffer
+	 *
+	 * @param buffer Buffer to write into
+	 */
+	MessageWriter::MessageWriter(ByteBuffer &buffer)
+		: mBuffer(buffer), mStart(buffer.EndOffset())
+	{
+	}
+
+	void MessageWriter::WriteU8(uint8_t val)
+	{
+		*mBuffer.Append(1) = static_cast<char>(val);
+	}
+
+	void MessageWriter::WriteU16(uint16_t val)
+	{
+		val = CS_Utils::cs_htons(val);
+		std::memcpy(mBuffer.Append(sizeof(val)), &val, sizeof(val));
+	}
+
+	void MessageWriter::WriteU32(uint32_t val)
+	{
+		val = CS_Utils::cs_htonl(val);
+		std::memcpy(mBuffer.Append(sizeof(val)), &val, sizeof(val));
+	}
+
+	void MessageWriter::WriteU64(uint64_t val)
+	{
+		val = CS_Utils::cs_htonll(val);
+		std::memcpy(mBuffer.Append(sizeof(val)), &val, sizeof(val));
+	}
+
+	void MessageWriter::WriteF32(float val)
+	{
+		uint32_t bits;
+		std::memcpy(&bits, &val, sizeof(bits));
+		WriteU32(bits);
+	}
+
+	void MessageWriter::WriteF64(double val)
+	{
+		uint64_t bits;
+		std::memcpy(&bits, &val, sizeof(bits));
+		WriteU64(bits);
+	}
+
+	/**
+	 * @brief Write raw bytes with no length prefix
+	 *
+	 * @param data Bytes to write
+	 * @param len Size (in bytes) of the data
+	 */
+	void MessageWriter::WriteBytes(const void *data, size_t len)
+	{
+		if (len > 0)
+		{
+			std::memcpy(mBuffer.Append(len), data, len);
+		}
+	}
+
+	/**
+	 * @brief Write a string with a 32-bit length prefix
+	 *
+	 * @param str String to write
+	 */
+	void MessageWriter::WriteString(std::string_view str)
+	{
+		WriteU32(static_cast<uint32_t>(str.size()));
+		WriteBytes(str.data(), str.size());
+	}
+
+	/**
+	 * @brief Reserve space for a 32-bit field to fill in later with PatchU32()
+	 *
+	 * @return Slot for PatchU32(). Slots are stream offsets, so they stay valid if the buffer is consumed up to the message in between
+	 */
+	size_t MessageWriter::ReserveU32()
+	{
+		size_t slot = mBuffer.EndOffset(); // An offset rather than a pointer, since the buffer may move as it grows or is consumed
+		mBuffer.Append(sizeof(uint32_t));
+		return slot;
+	}
+
+	/**
+	 * @brief Fill in a field reserved with ReserveU32()
+	 *
+	 * @param slot Slot returned by ReserveU32()
+	 * @param val Value to store
+	 */
+	void MessageWriter::PatchU32(size_t slot, uint32_t val)
+	{
+		val = CS_Utils::cs_htonl(val);
+		std::memcpy(mBuffer.At(slot), &val, sizeof(val));
+	}
+
+	/**
+	 * @brief Finish a nested section, storing the number of bytes written since BeginSection()
+	 *
+	 * @param slot Slot returned by BeginSection()
+	 */
+	void MessageWriter::EndSection(size_t slot)
+	{
+		PatchU32(slot, static_cast<uint32_t>(mBuffer.EndOffset() - slot - sizeof(uint32_t)));
+	}
+
+	/**
+	 * @brief Get space to write n bytes directly, such as with CS_Utils::cs_hton_array()
+	 *
+	 * @param n Number of bytes
+	 * @return Pointer to the space. Only valid until the next write
+	 */
+	char *MessageWriter::Extend(size_t n)
+	{
+		return mBuffer.Append(n);
+	}
+
+	/**
+	 * @brief Advance past n bytes, throwing if the message is too short
+	 *
+	 * @param n Number of bytes
+	 * @return Pointer to the first of the bytes
+	 */
+	const char *MessageReader::Take(size_t n)
+	{
+		if (n > mSize - mPos)
+		{
+			throw std::runtime_error("Message ended before the field being read");
+		}
+		const char *field = mData + mPos;
+		mPos += n;
+		return field;
+	}
+
+	uint8_t MessageReader::ReadU8()
+	{
+		return static_cast<uint8_t>(*Take(1));
+	}
+
+	uint16_t MessageReader::ReadU16()
+	{
+		uint16_t val;
+		std::memcpy(&val, Take(sizeof(val)), sizeof(val));
+		return CS_Utils::cs_ntohs(val);
+	}
+
+	uint32_t MessageReader::ReadU32()
+	{
+		uint32_t val;
+		std::memcpy(&val, Take(sizeof(val)), sizeof(val));
+		return CS_Utils::cs_ntohl(val);
+	}
+
+	uint64_t MessageReader::ReadU64()
+	{
+		uint64_t val;
+		std::memcpy(&val, Take(sizeof(val)), sizeof(val));
+		return CS_Utils::cs_ntohll(val);
+	}
+
+	float MessageReader::ReadF32()
+	{
+		uint32_t bits = ReadU32();
+		float val;
+		std::memcpy(&val, &bits, sizeof(val));
+		return val;
+	}
+
+	double MessageReader::ReadF64()
+	{
+		uint64_t bits = ReadU64();
+		double val;
+		std::memcpy(&val, &bits, sizeof(val));
+		return val;
+	}
+
+	/**
+	 * @brief Read raw bytes without copying them
+	 *
+	 * @param len Number of bytes
+	 * @return Pointer to the bytes inside the message
+	 */
+	const char *MessageReader::ReadBytes(size_t len)
+	{
+		return Take(len);
+	}
+
+	/**
+	 * @brief Read a string with a 32-bit length prefix without copying it
+	 *
+	 * @return View of the string inside the message
+	 */
+	std::string_view MessageReader::ReadString()
+	{
+		uint32_t len = ReadU32();
+		return std::string_view(Take(len), len);
+	}
+
+	/**
+	 * @brief Read a nested section written with MessageWriter::BeginSection()
+	 *
+	 * @return Reader limited to the section
+	 */
+	MessageReader MessageReader::ReadSection()
+	{
+		uint32_t len = ReadU32();
+		return MessageReader(Take(len), len);
+	}
+}
@@ -0,0 +1,102 @@
+#include "CrossSocket/RateLimiter.h"
+
+#include <limits>
+
+namespace CrossSocket
+{
+	/**
+	 * @brief Change the rate. The bucket starts full after every change
+	 *
+	 * @param bytesPerSecond Sustained rate. 0 removes the limit
+	 * @param burstBytes Largest burst allowed after an idle period. 0 picks 100 ms worth of the rate
+	 */
+	void TokenBucket::SetRate(uint64_t bytesPerSecond, uint64_t burstBytes)
+	{
+		mRate = bytesPerSecond;
+		mBurst = burstBytes > 0 ? burstBytes : bytesPerSecond / 10;
+		if (mBurst < PacketBytes)
+		{
+			mBurst = PacketBytes; // Always allow at least one full-sized packet
+		}
+		mTokens = static_cast<double>(mBurst);
+		mLast = Clock::now();
+	}
+
+	/**
+	 * @brief Add the tokens earned since the last refill, up to the burst size
+	 */
+	void TokenBucket::Refill()
+	{
+		Clock::time_point now = Clock::now();
+		std::chrono::duration<double> elapsed = now - mLast;
+		mLast = now;
+		mTokens += elapsed.count() * static_cast<double>(mRate);
+		if (mTokens > static_cast<double>(mBurst))
+		{
+			mTokens = static_cast<double>(mBurst);
+		}
+	}
+
+	/**
+	 * @brief Return how many bytes may be moved right now
+	 *
+	 * @return Bytes available. UINT64_MAX if the bucket has no limit
+	 */
+	uint64_t TokenBucket::Available()
+	{
+		if (mRate == 0)
+		{
+			return std::numeric_limits<uint64_t>::max();
+		}
+		Refill();
+		return mTokens >= 1.0 ? static_cast<uint64_t>(mTokens) : 0;
+	}
+
+	/**
+	 * @brief Charge moved bytes against the bucket. Charging more than is available borrows from the next refill
+	 *
+	 * @param bytes Number of bytes moved
+	 */
+	void TokenBucket::Consume(uint64_t bytes)
+	{
+		if (mRate > 0)
+		{
+			mTokens -= static_cast<double>(bytes);
+		}
+	}
+
+	/**
+	 * @brief Charge bytes only if the bucket can cover them now, for sends that cannot be split such as datagrams
+	 *
+	 * A charge bigger than the burst size goes through once the bucket is full, so it is slowed down rather than refused forever
+	 *
+	 * @param bytes Number of bytes to move
+	 * @return True if the bytes were charged and may be moved
+	 */
+	bool TokenBucket::TryConsume(uint64_t bytes)
+	{
+		uint64_t available = Available();
+		if (available < bytes && available < mBurst)
+		{
+			return false;
+		}
+		Consume(bytes);
+		return true;
+	}
+
+	/**
+	 * @brief Return how long until a full-sized packet can be moved. Waiting for that much avoids waking up for a trickle of bytes
+	 *
+	 * @return Time in milliseconds (0 if a packet's worth is available now)
+	 */
+	int TokenBucket::MillisUntilAvailable()
+	{
+		if (Available() >= PacketBytes)
+		{
+			return 0;
+		}
+		double seconds = (static_cast<double>(PacketBytes) - mTokens) / static_cast<double>(mRate);
+		int millis = static_cast<int>(seconds * 1000.0) + 1; // Round up so the loop never wakes before the refill
+		return millis;
+	}
+}
@@ -0,0 +1,330 @@
+#include "CrossSocket/Resolver.h"
+
+#include <cstring>
+#include <iterator>
+#include <stdexcept>
+
+namespace CrossSocket
+{
+	/**
+	 * @brief Create a Resolver with no threads running
+	 *
+	 * @param threads Number of lookup threads started on first use
+	 */
+	Resolver::Resolver(int threads)
+		: mThreadCount(threads < 1 ? 1 : threads), mStopping(false), mCacheTTL(DefaultCacheTTL),
+		  mNegativeCacheTTL(DefaultNegativeCacheTTL), mNextSweep(64), mNotify(INVALID_SOCKET)
+	{
+	}
+
+	/**
+	 * @brief Stop all lookup threads. Lookups still in flight are dropped without calling back
+	 */
+	Resolver::~Resolver()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mMutex);
+			mStopping = true;
+			mQueue.clear();
+		}
+		mWork.notify_all();
+		for (std::thread &thread : mThreads)
+		{
+			thread.join(); // A thread stuck inside getaddrinfo() holds this up until the lookup times out
+		}
+		if (mNotify != INVALID_SOCKET)
+		{
+			CS_Utils::close_socket(mNotify);
+		}
+	}
+
+	/**
+	 * @brief Start the lookup threads and notification socket
+	 */
+	void Resolver::Start()
+	{
+		CS_Utils::Initialize();
+
+		// A UDP socket connected to itself works as a wakeup for select() on every platform
+		mNotify = socket(AF_INET, SOCK_DGRAM, 0);
+		if (mNotify == INVALID_SOCKET)
+		{
+			throw std::runtime_error("Resolver notification socket creation failed " + std::to_string(CSERROR));
+		}
+
+		sockaddr_in addr{};
+		addr.sin_family = AF_INET;
+		addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+		socklen_t addrlen = sizeof(addr);
+		if (bind(mNotify, (sockaddr *)&addr, sizeof(addr)) == SOCKET_ERROR ||
+			getsockname(mNotify, (sockaddr *)&addr, &addrlen) == SOCKET_ERROR ||
+			connect(mNotify, (sockaddr *)&addr, sizeof(addr)) == SOCKET_ERROR)
+		{
+			int error = CSERROR;
+			CS_Utils::close_socket(mNotify);
+			mNotify = INVALID_SOCKET;
+			throw std::runtime_error("Resolver notification socket setup failed " + std::to_string(error));
+		}
+
+#ifdef _WIN32
+		u_long mode = 1;
+		ioctlsocket(mNotify, FIONBIO, &mode);
+#else
+		fcntl(mNotify, F_SETFL, fcntl(mNotify, F_GETFL, 0) | O_NONBLOCK);
+#endif // _WIN32
+
+		for (int i = 0; i < mThreadCount; ++i)
+		{
+			mThreads.emplace_back(&Resolver::Worker, this);
+		}
+	}
+
+	/**
+	 * @brief Lookup thread body
+	 */
+	void Resolver::Worker()
+	{
+		while (true)
+		{
+			Lookup lookup;
+			{
+				std::unique_lock<std::mutex> lock(mMutex);
+				mWork.wait(lock, [this]()
+						   { return mStopping || !mQueue.empty(); });
+				if (mStopping)
+				{
+					return;
+				}
+				lookup = std::move(mQueue.front());
+				mQueue.pop_front();
+			}
+
+			Resolution result = RunLookup(lookup);
+
+			{
+				std::lock_guard<std::mutex> lock(mMutex);
+				mFinished.push_back(Finished{lookup.key, std::move(result), {}});
+			}
+			char wake = 1;
+			send(mNotify, &wake, 1, 0);
+		}
+	}
+
+	/**
+	 * @brief Run getaddrinfo() for one lookup
+	 *
+	 * @param lookup Lookup to run
+	 * @return Lookup result
+	 */
+	Resolution Resolver::RunLookup(const Lookup &lookup)
+	{
+		Resolution result{lookup.host, lookup.port, 0, false, {}};
+
+		addrinfo hints{};
+		hints.ai_family = lookup.family;
+		hints.ai_socktype = SOCK_STREAM;
+
+		std::string service = std::to_string(lookup.port);
+		addrinfo *list = nullptr;
+		result.error = getaddrinfo(lookup.host.c_str(), service.c_str(), &hints, &list);
+		if (result.error != 0)
+		{
+			return result;
+		}
+
+		for (addrinfo *info = list; info != nullptr; info = info->ai_next)
+		{
+			if (info->ai_addrlen > sizeof(sockaddr_storage))
+			{
+				continue;
+			}
+			ResolvedAddress resolved{};
+			std::memcpy(&resolved.address, info->ai_addr, info->ai_addrlen);
+			resolved.length = static_cast<int>(info->ai_addrlen);
+			resolved.family = info->ai_family;
+			result.addresses.push_back(resolved);
+		}
+		freeaddrinfo(list);
+		return result;
+	}
+
+	/**
+	 * @brief Start resolving a host name. The callback runs from a later call to Dispatch()
+	 *
+	 * @param host Host name or numeric address
+	 * @param port Port to store in every returned address
+	 * @param family AF_INET, AF_INET6, or AF_UNSPEC for both
+	 * @param callback Function pointer to call with the result
+	 * @param userData Pointer passed back to the callback untouched
+	 */
+	void Resolver::Resolve(const char *host, u_short port, int family, Callback callback, void *userData)
+	{
+		if (mThreads.empty())
+		{
+			Start();
+		}
+
+		std::string key = std::string(host) + '|' + std::to_string(port) + '|' + std::to_string(family);
+
+		auto cached = mCache.find(key);
+		if (cached != mCache.end())
+		{
+			if (cached->second.expires > Clock::now())
+			{
+				Resolution result = cached->second.result;
+				result.cached = true;
+				{
+					std::lock_guard<std::mutex> lock(mMutex);
+					mFinished.push_back(Finished{key, std::move(result), {Waiter{callback, userData}}});
+				}
+				char wake = 1;
+				send(mNotify, &wake, 1, 0);
+				return;
+			}
+			mCache.erase(cached);
+		}
+
+		auto inFlight = mInFlight.find(key);
+		if (inFlight != mInFlight.end()) // Someone already asked for this name, share their lookup
+		{
+			inFlight->second.push_back(Waiter{callback, userData});
+			return;
+		}
+		mInFlight[key].push_back(Waiter{callback, userData});
+
+		{
+			std::lock_guard<std::mutex> lock(mMutex);
+			mQueue.push_back(Lookup{key, host, port, family});
+		}
+		mWork.notify_one();
+	}
+
+	/**
+	 * @brief Run callbacks for every finished lookup
+	 *
+	 * @return Number of callbacks run
+	 */
+	int Resolver::Dispatch()
+	{
+		if (mNotify == INVALID_SOCKET)
+		{
+			return 0;
+		}
+
+		char drain[64];
+		while (recv(mNotify, drain, sizeof(drain), 0) > 0)
+		{
+		}
+
+		std::vector<Finished> finished;
+		{
+			std::lock_guard<std::mutex> lock(mMutex);
+			finished.swap(mFinished);
+		}
+
+		int dispatched = 0;
+		for (Finished &done : finished)
+		{
+			if (!done.result.cached)
+			{
+				auto inFlight = mInFlight.find(done.key);
+				if (inFlight != mInFlight.end())
+				{
+					done.waiters = std::move(inFlight->second);
+					mInFlight.erase(inFlight);
+				}
+
+				int ttl = done.result.error == 0 ? mCacheTTL : mNegativeCacheTTL;
+				if (ttl > 0)
+				{
+					CacheResult(done.key, done.result, Clock::now() + std::chrono::milliseconds(ttl));
+				}
+			}
+
+			for (Waiter &waiter : done.waiters)
+			{
+				waiter.callback(done.result, waiter.userData);
+				++dispatched;
+			}
+		}
+		return dispatched;
+	}
+
+	/**
+	 * @brief Store a finished lookup, first removing expired entries if the cache has grown enough to be worth sweeping
+	 *
+	 * @param key Cache key of the lookup
+	 * @param result Lookup result
+	 * @param expires Time the entry stops being used
+	 */
+	void Resolver::CacheResult(const std::string &key, const Resolution &result, Clock::time_point expires)
+	{
+		// Entries are otherwise only removed when the same name is looked up again, so a stream of unique names would never be freed
+		if (mCache.size() >= mNextSweep)
+		{
+			Clock::time_point now = Clock::now();
+			for (auto it = mCache.begin(); it != mCache.end();)
+			{
+				it = it->second.expires <= now ? mCache.erase(it) : std::next(it);
+			}
+			mNextSweep = mCache.size() * 2 > 64 ? mCache.size() * 2 : 64; // Sweeps stay amortized O(1) per insert
+		}
+
+		if (mCache.size() >= MaxCacheEntries && mCache.find(key) == mCache.end())
+		{
+			auto soonest = mCache.begin();
+			for (auto it = mCache.begin(); it != mCache.end(); ++it)
+			{
+				if (it->second.expires < soonest->second.expires)
+				{
+					soonest = it;
+				}
+			}
+			mCache.erase(soonest);
+		}
+
+		mCache[key] = CacheEntry{result, expires};
+	}
+
+	/**
+	 * @brief Check if any finished lookups are waiting for Dispatch()
+	 *
+	 * @return True if Dispatch() has work to do
+	 */
+	bool Resolver::HasPending()
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		return !mFinished.empty();
+	}
+
+	/**
+	 * @brief Return the socket that becomes readable when lookups finish
+	 *
+	 * @return Notification socket (INVALID_SOCKET until the first Resolve())
+	 */
+	socket_t Resolver::GetNotifyHandle() const
+	{
+		return mNotify;
+	}
+
+	/**
+	 * @brief Set how long lookups stay cached
+	 *
+	 * @param ttlMillis Time for successful lookups in milliseconds. 0 disables caching
+	 * @param negativeTtlMillis Time for failed lookups in milliseconds. 0 disables caching
+	 */
+	void Resolver::SetCacheTTL(int ttlMillis, int negativeTtlMillis)
+	{
+		mCacheTTL = ttlMillis;
+		mNegativeCacheTTL = negativeTtlMillis;
+	}
+
+	/**
+	 * @brief Remove every cached lookup
+	 */
+	void Resolver::ClearCache()
+	{
+		mCache.clear();
+		mNextSweep = 64;
+	}
+}
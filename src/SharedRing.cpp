@@ -0,0 +1,581 @@
+#include "CrossSocket/SharedRing.h"
+#include "CrossSocket/Log.h"
+
+#ifdef __linux__
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/eventfd.h>
+#include <poll.h>
+
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <new>
+#include <stdexcept>
+#include <string>
+
+namespace CrossSocket
+{
+	/**
+	 * @brief Control block for one direction of the link, placed at the start of the shared memory
+	 *
+	 * head and tail are free-running byte counters on separate cache lines so the producer and consumer never write the same line
+	 */
+	struct SharedRing::RingHeader
+	{
+		alignas(64) std::atomic<uint64_t> head;			 // Written by the producer
+		alignas(64) std::atomic<uint64_t> tail;			 // Written by the consumer
+		alignas(64) std::atomic<uint32_t> consumerWaiting; // Set while the consumer is asleep on dataFd
+		std::atomic<uint32_t> producerWaiting;			 // Set while the producer is asleep on spaceFd
+		std::atomic<uint32_t> closed;
+		uint64_t capacity;
+	};
+
+	namespace
+	{
+		constexpr size_t HeaderBlock = 4096; // Both RingHeaders share the first page
+		constexpr int PassedFds = 5;		 // memfd + (dataFd, spaceFd) for each direction
+
+		inline void CpuRelax()
+		{
+#if defined(__x86_64__) || defined(__i386__)
+			__builtin_ia32_pause();
+#elif defined(__aarch64__)
+			asm volatile("yield");
+#endif
+		}
+
+		inline void Signal(int fd)
+		{
+			uint64_t one = 1;
+			ssize_t ignored = write(fd, &one, sizeof(one)); // The eventfd counter saturating is harmless, the peer only needs one wakeup
+			(void)ignored;
+		}
+
+		inline void Drain(int fd)
+		{
+			uint64_t count;
+			ssize_t ignored = read(fd, &count, sizeof(count));
+			(void)ignored;
+		}
+	}
+
+	/**
+	 * @brief Create an unconnected SharedRing
+	 */
+	SharedRing::SharedRing()
+		: mMemFd(-1), mMapping(nullptr), mMappingSize(0), mTx{nullptr, nullptr, -1, -1}, mRx{nullptr, nullptr, -1, -1},
+		  mNonblocking(false), mSpinCount(DefaultSpinCount)
+	{
+	}
+
+	/**
+	 * @brief SharedRing destructor
+	 */
+	SharedRing::~SharedRing()
+	{
+		Close();
+	}
+
+	/**
+	 * @brief Send an error message, close the ring, and throw an exception
+	 *
+	 * @param message Error message. Must be a string literal, since its address keys log rate limiting
+	 * @param errorCode Error code
+	 */
+	void SharedRing::Error(const char *message, int errorCode)
+	{
+		CS_LOG_SITE(LogLevel::Error, message, "{} {}", message, errorCode); // Callers pass literals, so each error is limited on its own
+		std::string err = std::string(message) + " " + std::to_string(errorCode);
+		Close();
+		throw std::runtime_error(err);
+	}
+
+	/**
+	 * @brief Map the shared memory and assign both channels
+	 *
+	 * @param creator True if this side created the memory (and therefore produces into the first ring)
+	 */
+	void SharedRing::Map(bool creator)
+	{
+		struct stat info{};
+		if (fstat(mMemFd, &info) == -1)
+		{
+			Error("fstat() failed on shared memory", errno);
+		}
+		mMappingSize = static_cast<size_t>(info.st_size);
+
+		void *mapping = mmap(nullptr, mMappingSize, PROT_READ | PROT_WRITE, MAP_SHARED, mMemFd, 0);
+		if (mapping == MAP_FAILED)
+		{
+			Error("mmap() failed on shared memory", errno);
+		}
+		mMapping = mapping;
+
+		char *base = static_cast<char *>(mMapping);
+		RingHeader *first;
+		RingHeader *second;
+		if (creator)
+		{
+			first = new (base) RingHeader{};
+			second = new (base + HeaderBlock / 2) RingHeader{};
+			first->capacity = second->capacity = (mMappingSize - HeaderBlock) / 2;
+		}
+		else
+		{
+			first = reinterpret_cast<RingHeader *>(base);
+			second = reinterpret_cast<RingHeader *>(base + HeaderBlock / 2);
+			// Offsets are masked with capacity - 1, so anything but a matching power of two would index out of the mapping
+			uint64_t capacity = first->capacity;
+			if (capacity == 0 || (capacity & (capacity - 1)) != 0 || second->capacity != capacity || HeaderBlock + capacity * 2 != mMappingSize)
+			{
+				Error("Shared memory has an invalid layout", EINVAL);
+			}
+		}
+
+		char *firstData = base + HeaderBlock;
+		char *secondData = firstData + first->capacity;
+
+		// The creator produces into the first ring and consumes from the second. The joiner does the opposite
+		mTx.header = creator ? first : second;
+		mTx.data = creator ? firstData : secondData;
+		mRx.header = creator ? second : first;
+		mRx.data = creator ? secondData : firstData;
+	}
+
+	/**
+	 * @brief Create the shared memory and hand it to the peer over a connected AF_UNIX Socket
+	 *
+	 * @param channel Connected AF_UNIX Socket to the peer
+	 * @param capacity Size (in bytes) of each direction. Rounded up to a power of two
+	 */
+	void SharedRing::Offer(Socket &channel, size_t capacity)
+	{
+		Close();
+
+		size_t rounded = 4096;
+		while (rounded < capacity)
+		{
+			rounded <<= 1;
+		}
+
+		mMemFd = memfd_create("CrossSocket", MFD_CLOEXEC);
+		if (mMemFd == -1)
+		{
+			Error("memfd_create() failed", errno);
+		}
+		if (ftruncate(mMemFd, static_cast<off_t>(HeaderBlock + rounded * 2)) == -1)
+		{
+			Error("ftruncate() failed on shared memory", errno);
+		}
+
+		int *eventFds[] = {&mTx.dataFd, &mTx.spaceFd, &mRx.dataFd, &mRx.spaceFd};
+		for (int *fd : eventFds)
+		{
+			*fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+			if (*fd == -1)
+			{
+				Error("eventfd() failed", errno);
+			}
+		}
+
+		Map(true);
+
+		int fds[PassedFds] = {mMemFd, mTx.dataFd, mTx.spaceFd, mRx.dataFd, mRx.spaceFd};
+		char control[CMSG_SPACE(sizeof(fds))] = {};
+		char tag = 'R';
+		iovec iov{&tag, 1};
+
+		msghdr msg{};
+		msg.msg_iov = &iov;
+		msg.msg_iovlen = 1;
+		msg.msg_control = control;
+		msg.msg_controllen = sizeof(control);
+
+		cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+		cmsg->cmsg_level = SOL_SOCKET;
+		cmsg->cmsg_type = SCM_RIGHTS;
+		cmsg->cmsg_len = CMSG_LEN(sizeof(fds));
+		std::memcpy(CMSG_DATA(cmsg), fds, sizeof(fds));
+
+		if (sendmsg(channel.GetRawSocket(), &msg, MSG_NOSIGNAL) == -1)
+		{
+			Error("Failed to pass shared memory to peer", errno);
+		}
+	}
+
+	/**
+	 * @brief Receive shared memory offered by the peer over a connected AF_UNIX Socket
+	 *
+	 * @param channel Connected AF_UNIX Socket to the peer
+	 */
+	void SharedRing::Join(Socket &channel)
+	{
+		Close();
+
+		int fds[PassedFds];
+		char control[CMSG_SPACE(sizeof(fds))] = {};
+		char tag = 0;
+		iovec iov{&tag, 1};
+
+		msghdr msg{};
+		msg.msg_iov = &iov;
+		msg.msg_iovlen = 1;
+		msg.msg_control = control;
+		msg.msg_controllen = sizeof(control);
+
+		ssize_t received;
+		do
+		{
+			received = recvmsg(channel.GetRawSocket(), &msg, MSG_CMSG_CLOEXEC);
+		} while (received == -1 && errno == EINTR);
+		if (received <= 0)
+		{
+			Error("Failed to receive shared memory from peer", received == 0 ? ECONNRESET : errno);
+		}
+
+		cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+		if (cmsg == nullptr || cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS || cmsg->cmsg_len != CMSG_LEN(sizeof(fds)) || tag != 'R')
+		{
+			// SCM_RIGHTS installs the descriptors before they can be checked, so close whatever arrived
+			for (cmsghdr *c = CMSG_FIRSTHDR(&msg); c != nullptr; c = CMSG_NXTHDR(&msg, c))
+			{
+				if (c->cmsg_level == SOL_SOCKET && c->cmsg_type == SCM_RIGHTS)
+				{
+					size_t count = (c->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+					for (size_t n = 0; n < count; ++n)
+					{
+						int fd;
+						std::memcpy(&fd, CMSG_DATA(c) + n * sizeof(int), sizeof(fd));
+						close(fd);
+					}
+				}
+			}
+			Error("Peer did not offer a SharedRing", EPROTO);
+		}
+		std::memcpy(fds, CMSG_DATA(cmsg), sizeof(fds));
+
+		// The peer's transmit ring is our receive ring and vice versa
+		mMemFd = fds[0];
+		mRx.dataFd = fds[1];
+		mRx.spaceFd = fds[2];
+		mTx.dataFd = fds[3];
+		mTx.spaceFd = fds[4];
+
+		Map(false);
+	}
+
+	/**
+	 * @brief Close the ring and wake the peer so it can see the close
+	 */
+	void SharedRing::Close()
+	{
+		if (mMapping != nullptr)
+		{
+			if (mTx.header != nullptr)
+			{
+				mTx.header->closed.store(1, std::memory_order_release);
+				mRx.header->closed.store(1, std::memory_order_release);
+				Signal(mTx.dataFd);
+				Signal(mRx.spaceFd);
+			}
+			munmap(mMapping, mMappingSize);
+			mMapping = nullptr;
+			mMappingSize = 0;
+		}
+
+		int *fds[] = {&mMemFd, &mTx.dataFd, &mTx.spaceFd, &mRx.dataFd, &mRx.spaceFd};
+		for (int *fd : fds)
+		{
+			if (*fd != -1)
+			{
+				close(*fd);
+				*fd = -1;
+			}
+		}
+		mTx.header = mRx.header = nullptr;
+		mTx.data = mRx.data = nullptr;
+	}
+
+	/**
+	 * @brief Allow Receive() to return immediately when no data is present (default mode waits for data)
+	 *
+	 * @param enable True to enable nonblocking mode. False to enable waiting
+	 */
+	void SharedRing::SetNonblockingMode(bool enable)
+	{
+		mNonblocking = enable;
+	}
+
+	/**
+	 * @brief Set how many times a waiting side polls shared memory before sleeping on its eventfd
+	 *
+	 * @param spins Number of polls. 0 to sleep immediately
+	 */
+	void SharedRing::SetSpinCount(int spins)
+	{
+		mSpinCount = spins < 0 ? 0 : spins;
+	}
+
+	/**
+	 * @brief Wait until a ring position moves away from a value, spinning first and then sleeping on an eventfd
+	 *
+	 * @param channel Channel to wait on
+	 * @param waitForData True to wait for data as the consumer. False to wait for space as the producer
+	 * @param timeoutMillis Maximum time to sleep once spinning gives up (-1 for no limit)
+	 * @return True if the condition was met. False if the wait timed out or the peer closed the ring
+	 */
+	bool SharedRing::Wait(Channel &channel, bool waitForData, int timeoutMillis)
+	{
+		RingHeader *header = channel.header;
+		auto ready = [header, waitForData]()
+		{
+			uint64_t used = header->head.load(std::memory_order_acquire) - header->tail.load(std::memory_order_acquire);
+			return waitForData ? used != 0 : used != header->capacity;
+		};
+
+		for (int i = 0; i < mSpinCount; ++i)
+		{
+			if (ready())
+			{
+				return true;
+			}
+			if (header->closed.load(std::memory_order_acquire))
+			{
+				return false;
+			}
+			CpuRelax();
+		}
+
+		std::atomic<uint32_t> &waiting = waitForData ? header->consumerWaiting : header->producerWaiting;
+		int fd = waitForData ? channel.dataFd : channel.spaceFd;
+		while (true)
+		{
+			// Publish the flag before the final check so a peer that moves the ring after the check is guaranteed to see it
+			waiting.store(1, std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			if (ready() || header->closed.load(std::memory_order_acquire))
+			{
+				waiting.store(0, std::memory_order_relaxed);
+				return ready();
+			}
+
+			pollfd pfd{fd, POLLIN, 0};
+			int result = poll(&pfd, 1, timeoutMillis);
+			waiting.store(0, std::memory_order_relaxed);
+			if (result < 0 && errno != EINTR)
+			{
+				Error("poll() failed on shared memory notification", errno);
+			}
+			if (result > 0)
+			{
+				Drain(fd);
+			}
+
+			if (ready())
+			{
+				return true;
+			}
+			if (header->closed.load(std::memory_order_acquire) || (result == 0 && timeoutMillis >= 0))
+			{
+				return false;
+			}
+		}
+	}
+
+	/**
+	 * @brief Check if the ring has data to read
+	 *
+	 * @param timeoutMillis Timeout for check in milliseconds
+	 * @return Ring read readiness
+	 */
+	bool SharedRing::IsReadyToRead(int timeoutMillis)
+	{
+		if (mMapping == nullptr)
+		{
+			return false;
+		}
+		RingHeader *header = mRx.header;
+		if (header->head.load(std::memory_order_acquire) != header->tail.load(std::memory_order_relaxed) || header->closed.load(std::memory_order_acquire))
+		{
+			return true; // Like a socket at end of stream, a closed ring reports readable so Receive() can return 0
+		}
+		return timeoutMillis != 0 && (Wait(mRx, true, timeoutMillis) || header->closed.load(std::memory_order_acquire));
+	}
+
+	/**
+	 * @brief Check if the ring has space to write
+	 *
+	 * @param timeoutMillis Timeout for check in milliseconds
+	 * @return Ring write readiness
+	 */
+	bool SharedRing::IsReadyToWrite(int timeoutMillis)
+	{
+		if (mMapping == nullptr)
+		{
+			return false;
+		}
+		RingHeader *header = mTx.header;
+		if (header->head.load(std::memory_order_relaxed) - header->tail.load(std::memory_order_acquire) != header->capacity)
+		{
+			return true;
+		}
+		return timeoutMillis != 0 && Wait(mTx, false, timeoutMillis);
+	}
+
+	/**
+	 * @brief Send data to the peer. Waits for space until all of the data has been written
+	 *
+	 * @param buf Data to send
+	 * @param len Size (in bytes) of the data to send
+	 * @param flags Sending flags (unused, kept for parity with Socket::Send())
+	 */
+	void SharedRing::Send(const char *buf, int len, int flags)
+	{
+		(void)flags;
+		if (mMapping == nullptr)
+		{
+			throw std::runtime_error("Send failed, SharedRing is not connected");
+		}
+
+		RingHeader *header = mTx.header;
+		const uint64_t capacity = header->capacity;
+		const uint64_t mask = capacity - 1;
+
+		int total_sent = 0;
+		while (total_sent < len)
+		{
+			if (header->closed.load(std::memory_order_acquire))
+			{
+				Error("Send failed with error", EPIPE);
+			}
+
+			uint64_t head = header->head.load(std::memory_order_relaxed);
+			uint64_t space = capacity - (head - header->tail.load(std::memory_order_acquire));
+			if (space == 0)
+			{
+				if (!Wait(mTx, false, -1))
+				{
+					Error("Send failed with error", EPIPE);
+				}
+				continue;
+			}
+
+			uint64_t count = static_cast<uint64_t>(len - total_sent);
+			if (count > space)
+			{
+				count = space;
+			}
+			uint64_t offset = head & mask;
+			uint64_t first = capacity - offset < count ? capacity - offset : count;
+			std::memcpy(mTx.data + offset, buf + total_sent, first);
+			std::memcpy(mTx.data, buf + total_sent + first, count - first);
+
+			header->head.store(head + count, std::memory_order_release);
+			total_sent += static_cast<int>(count);
+
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			if (header->consumerWaiting.load(std::memory_order_relaxed))
+			{
+				Signal(mTx.dataFd);
+			}
+		}
+	}
+
+	/**
+	 * @brief Receive data from the peer
+	 *
+	 * @param buf Destination to store data
+	 * @param len Size (in bytes) of the data received
+	 * @param flags Receiving flags (unused, kept for parity with Socket::Receive())
+	 * @return Data size in bytes. Less than len if the peer closed the ring or nonblocking mode is on
+	 */
+	int SharedRing::Receive(char *buf, int len, int flags)
+	{
+		(void)flags;
+		if (mMapping == nullptr)
+		{
+			throw std::runtime_error("Receive failed, SharedRing is not connected");
+		}
+
+		RingHeader *header = mRx.header;
+		const uint64_t capacity = header->capacity;
+		const uint64_t mask = capacity - 1;
+
+		int bytesReceived = 0;
+		while (bytesReceived < len)
+		{
+			uint64_t tail = header->tail.load(std::memory_order_relaxed);
+			uint64_t available = header->head.load(std::memory_order_acquire) - tail;
+			if (available == 0)
+			{
+				if (mNonblocking || !Wait(mRx, true, -1))
+				{
+					return bytesReceived;
+				}
+				continue;
+			}
+
+			uint64_t count = static_cast<uint64_t>(len - bytesReceived);
+			if (count > available)
+			{
+				count = available;
+			}
+			uint64_t offset = tail & mask;
+			uint64_t first = capacity - offset < count ? capacity - offset : count;
+			std::memcpy(buf + bytesReceived, mRx.data + offset, first);
+			std::memcpy(buf + bytesReceived + first, mRx.data, count - first);
+
+			header->tail.store(tail + count, std::memory_order_release);
+			bytesReceived += static_cast<int>(count);
+
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			if (header->producerWaiting.load(std::memory_order_relaxed))
+			{
+				Signal(mRx.spaceFd);
+			}
+		}
+		return bytesReceived;
+	}
+
+	/**
+	 * @brief Return the descriptor that becomes readable when the peer wakes this side up
+	 *
+	 * @return eventfd for incoming data
+	 */
+	int SharedRing::GetNotifyHandle() const
+	{
+		return mRx.dataFd;
+	}
+
+	/**
+	 * @brief Arm the incoming data notification before going to sleep in an event loop
+	 *
+	 * @return True if data arrived while arming, in which case the caller should not sleep
+	 */
+	bool SharedRing::ArmReadNotify()
+	{
+		if (mMapping == nullptr)
+		{
+			return false;
+		}
+		RingHeader *header = mRx.header;
+		header->consumerWaiting.store(1, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		return header->head.load(std::memory_order_acquire) != header->tail.load(std::memory_order_relaxed) || header->closed.load(std::memory_order_acquire);
+	}
+
+	/**
+	 * @brief Disarm the incoming data notification and clear any pending wakeup
+	 */
+	void SharedRing::DisarmReadNotify()
+	{
+		if (mMapping == nullptr)
+		{
+			return;
+		}
+		mRx.header->consumerWaiting.store(0, std::memory_order_relaxed);
+		Drain(mRx.dataFd);
+	}
+}
+#endif // __linux__
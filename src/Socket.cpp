@@ -1,6 +1,19 @@
 #include "CrossSocket/Socket.h"
+#include "CrossSocket/Log.h"
 
-#include <iostream>
+#ifdef __linux__
+#include <linux/errqueue.h>
+#include <linux/net_tstamp.h>
+#include <sys/uio.h>
+
+#ifndef SO_PREFER_BUSY_POLL
+#define SO_PREFER_BUSY_POLL 69 // Linux 5.11+, missing from older libc headers
+#endif // SO_PREFER_BUSY_POLL
+#endif // __linux__
+
+#include <cstring>
+#include <limits>
+#include <stdexcept>
 #include <string>
 
 namespace CrossSocket
@@ -21,7 +34,7 @@ namespace CrossSocket
 		}
 		else
 		{
-			std::cerr << "Winsock not initialized" << std::endl;
+			CS_LOG_ERROR("Winsock not initialized");
 			mSocket = 0;
 			throw std::runtime_error("Winsock not initialized");
 		}
@@ -40,7 +53,33 @@ namespace CrossSocket
 		}
 		else // If there was an initialization failure, error
 		{
-			std::cerr << "Winsock not initialized" << std::endl; // Specifying Winsock because the CrossSocket does not require initialization on Unix machines
+			CS_LOG_ERROR("Winsock not initialized"); // Specifying Winsock because the CrossSocket does not require initialization on Unix machines
+			mSocket = 0;
+			throw std::runtime_error("Winsock not initialized");
+		}
+	}
+
+	/**
+	 * @brief Create a new Socket object with a specific address family and type
+	 *
+	 * @param family Address family (AF_INET, AF_INET6, AF_UNIX, ...)
+	 * @param type Socket type (SOCK_STREAM, SOCK_DGRAM, ...)
+	 * @param protocol Protocol (if no value passed, 0)
+	 */
+	Socket::Socket(int family, int type, int protocol)
+	{
+		if (CS_Utils::Initialize()) // If CrossSocket has not been initialized, attempt to initialize it
+		{
+			mSocket = socket(family, type, protocol);
+			if (mSocket == INVALID_SOCKET)
+			{
+				CS_Utils::Cleanup();
+				throw std::runtime_error("Socket creation failed " + std::to_string(CSERROR));
+			}
+		}
+		else
+		{
+			CS_LOG_ERROR("Winsock not initialized");
 			mSocket = 0;
 			throw std::runtime_error("Winsock not initialized");
 		}
@@ -57,13 +96,13 @@ namespace CrossSocket
 	/**
 	 * @brief Send an error message, close the socket, shut down CrossSocket, and throw and exception
 	 *
-	 * @param message Error message
+	 * @param message Error message. Must be a string literal, since its address keys log rate limiting
 	 * @param errorCode Error code
 	 */
 	void Socket::Error(const char *message, int errorCode)
 	{
+		CS_LOG_SITE(LogLevel::Error, message, "{} {}", message, errorCode); // Callers pass literals, so each error is limited on its own
 		std::string err = std::string(message) + " " + std::to_string(errorCode);
-		std::cerr << err << std::endl;
 		Close();
 		CS_Utils::Cleanup();
 		throw std::runtime_error(err);
@@ -80,6 +119,10 @@ namespace CrossSocket
 			CS_Utils::close_socket(mSocket);
 			mSocket = INVALID_SOCKET;
 		}
+		mSendQueue.clear(); // Release shared payloads so they are not held by a dead connection
+		mQueuedBytes = 0;
+		mSendBuffer.Clear();
+		mOpenMessage = NoMessage;
 	}
 
 	/**
@@ -131,32 +174,79 @@ namespace CrossSocket
 #endif // _WIN32
 	}
 
+	/**
+	 * @brief Let the kernel busy-poll the device queue on blocking receives and select() instead of waiting for an interrupt (Linux only)
+	 *
+	 * @param micros Time to busy-poll in microseconds. 0 disables busy polling
+	 * @param prefer Also set SO_PREFER_BUSY_POLL so the kernel defers interrupts while the application polls
+	 * @return True if the options were applied. False if the platform does not support them or the caller lacks permission
+	 */
+	bool Socket::SetBusyPoll(int micros, bool prefer)
+	{
+#if defined(__linux__) && defined(SO_BUSY_POLL)
+		if (setsockopt(mSocket, SOL_SOCKET, SO_BUSY_POLL, &micros, sizeof(micros)) == SOCKET_ERROR)
+		{
+			return false; // Raising the value above net.core.busy_read needs CAP_NET_ADMIN
+		}
+		int enable = prefer ? 1 : 0;
+		return setsockopt(mSocket, SOL_SOCKET, SO_PREFER_BUSY_POLL, &enable, sizeof(enable)) != SOCKET_ERROR || !prefer;
+#else
+		(void)micros;
+		(void)prefer;
+		return false;
+#endif
+	}
+
 	/**
 	 * @brief Connect a CLIENT Socket to a SERVER Socket
 	 *
-	 * @param family Address family, usually AF_INET (IPv4)
-	 * @param address IP Address of the server
+	 * @param family Address family: AF_INET (IPv4), AF_INET6 (IPv6), or AF_UNSPEC to accept either literal
+	 * @param address Numeric IP Address of the server. Use SocketManager::Resolve() for host names
 	 * @param port Port the Server Socket is on
 	 */
 	void Socket::ConnectTo(short family, const char *address, u_short port)
 	{
-		sockaddr_in server{};
-		server.sin_family = family;
-		server.sin_port = htons(port);
+		sockaddr_storage server{};
+		int serverlen = 0;
 
-		if (inet_pton(family, address, &server.sin_addr) <= 0)
+		sockaddr_in *server4 = reinterpret_cast<sockaddr_in *>(&server);
+		sockaddr_in6 *server6 = reinterpret_cast<sockaddr_in6 *>(&server);
+		if ((family == AF_INET || family == AF_UNSPEC) && inet_pton(AF_INET, address, &server4->sin_addr) > 0)
+		{
+			server4->sin_family = AF_INET;
+			server4->sin_port = htons(port);
+			serverlen = sizeof(sockaddr_in);
+		}
+		else if ((family == AF_INET6 || family == AF_UNSPEC) && inet_pton(AF_INET6, address, &server6->sin6_addr) > 0)
+		{
+			server6->sin6_family = AF_INET6;
+			server6->sin6_port = htons(port);
+			serverlen = sizeof(sockaddr_in6);
+		}
+		else
 		{
 			throw std::runtime_error("Invalid address");
 		}
 
-		if (connect(mSocket, (sockaddr *)&server, sizeof(server)) == SOCKET_ERROR)
+		ConnectTo(reinterpret_cast<sockaddr *>(&server), serverlen);
+	}
+
+	/**
+	 * @brief Connect a CLIENT Socket to an already resolved address
+	 *
+	 * @param address Address of the server, such as one returned by SocketManager::Resolve()
+	 * @param addrlen Size (in bytes) of the address
+	 */
+	void Socket::ConnectTo(const sockaddr *address, int addrlen)
+	{
+		if (connect(mSocket, address, addrlen) == SOCKET_ERROR)
 		{
 			int error = CSERROR;
 			if (error != CSEWOULDBLOCK && error != CSEINPROGRESS && error != CSEALREADY)
 			{
 				if (error == CSECONNREFUSED)
 				{
-					std::cout << "Connection refused. Retrying..." << std::endl;
+					CS_LOG_INFO("Connection refused. Retrying...");
 				}
 				else
 				{
@@ -173,16 +263,99 @@ namespace CrossSocket
 	 */
 	void Socket::BindTo(u_short port)
 	{
-		sockaddr_in addr{};
-		addr.sin_family = AF_INET;
-		addr.sin_addr.s_addr = INADDR_ANY;
-		addr.sin_port = htons(port);
+		BindTo(AF_INET, port);
+	}
+
+	/**
+	 * @brief Bind a SERVER Socket to a port on every local address of a family
+	 *
+	 * @param family AF_INET (IPv4) or AF_INET6 (IPv6). The Socket must have been created with the same family
+	 * @param port Port to bind to
+	 * @param dualStack For AF_INET6, also accept IPv4 connections as IPv4-mapped addresses (if no value passed, true)
+	 */
+	void Socket::BindTo(short family, u_short port, bool dualStack)
+	{
+		sockaddr_storage addr{};
+		int addrlen = 0;
+
+		if (family == AF_INET6)
+		{
+			// The IPV6_V6ONLY default differs between platforms (on by default on Windows), so always set it explicitly
+			int v6only = dualStack ? 0 : 1;
+			if (setsockopt(mSocket, IPPROTO_IPV6, IPV6_V6ONLY, (const char *)&v6only, sizeof(v6only)) == SOCKET_ERROR)
+			{
+				Error("Failed to set IPV6_V6ONLY", CSERROR);
+			}
+
+			sockaddr_in6 *addr6 = reinterpret_cast<sockaddr_in6 *>(&addr);
+			addr6->sin6_family = AF_INET6;
+			addr6->sin6_addr = in6addr_any;
+			addr6->sin6_port = htons(port);
+			addrlen = sizeof(sockaddr_in6);
+		}
+		else
+		{
+			sockaddr_in *addr4 = reinterpret_cast<sockaddr_in *>(&addr);
+			addr4->sin_family = AF_INET;
+			addr4->sin_addr.s_addr = INADDR_ANY;
+			addr4->sin_port = htons(port);
+			addrlen = sizeof(sockaddr_in);
+		}
+
+		if (bind(mSocket, (sockaddr *)&addr, addrlen) == SOCKET_ERROR)
+		{
+			Error("Bind failed", CSERROR);
+		}
+	}
+
+#ifndef _WIN32
+	/**
+	 * @brief Connect a CLIENT Socket to a SERVER Socket over a local (AF_UNIX) path
+	 *
+	 * @param path Filesystem path the Server Socket is bound to
+	 */
+	void Socket::ConnectToLocal(const char *path)
+	{
+		sockaddr_un server{};
+		server.sun_family = AF_UNIX;
+		if (std::strlen(path) >= sizeof(server.sun_path))
+		{
+			throw std::runtime_error("Invalid address");
+		}
+		std::strncpy(server.sun_path, path, sizeof(server.sun_path) - 1);
+
+		if (connect(mSocket, (sockaddr *)&server, sizeof(server)) == SOCKET_ERROR)
+		{
+			int error = CSERROR;
+			if (error != CSEWOULDBLOCK && error != CSEINPROGRESS && error != CSEALREADY)
+			{
+				Error("Connection failed with error", error);
+			}
+		}
+	}
+
+	/**
+	 * @brief Bind a local (AF_UNIX) SERVER Socket to a filesystem path
+	 *
+	 * @param path Filesystem path to bind to. Any stale file at that path is removed first
+	 */
+	void Socket::BindToLocal(const char *path)
+	{
+		sockaddr_un addr{};
+		addr.sun_family = AF_UNIX;
+		if (std::strlen(path) >= sizeof(addr.sun_path))
+		{
+			throw std::runtime_error("Invalid address");
+		}
+		std::strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1);
+		unlink(path); // A previous server that did not clean up leaves the path behind, which makes bind() fail
 
 		if (bind(mSocket, (sockaddr *)&addr, sizeof(addr)) == SOCKET_ERROR)
 		{
 			Error("Bind failed", CSERROR);
 		}
 	}
+#endif // _WIN32
 
 	/**
 	 * @brief Tell the SERVER Socket to listen for connections
@@ -273,6 +446,25 @@ namespace CrossSocket
 	 */
 	void Socket::Send(const char *buf, int len, int flags)
 	{
+		if (PendingSendBytes() > 0 || mSendLimit.IsLimited())
+		{
+			// Stay in order behind queued output, and leave whatever the send limit does not allow yet for Flush() to pace out
+			if (mOpenMessage != NoMessage)
+			{
+				QueuePayload(MakePayload(buf, static_cast<size_t>(len)), false); // Never appended after an open message, which would split its frame
+			}
+			else
+			{
+				std::memcpy(mSendBuffer.Append(static_cast<size_t>(len)), buf, static_cast<size_t>(len));
+				if (!mSendQueue.empty())
+				{
+					MoveSendBufferToQueue();
+				}
+			}
+			Flush(flags);
+			return;
+		}
+
 		int total_sent = 0;
 		while (total_sent < len)
 		{
@@ -283,11 +475,14 @@ namespace CrossSocket
 			}
 			total_sent += sent;
 		}
+		mBytesSent += static_cast<uint64_t>(total_sent);
 	}
 
 	/**
 	 * @brief Send data through a UDP connection
 	 *
+	 * With a send limit set, a datagram the limit cannot cover yet is dropped and counted in GetRateStats().sendThrottled
+	 *
 	 * @param buf Data to send
 	 * @param len Size (in bytes) of the data to send
 	 * @param flags Sending flags
@@ -296,10 +491,22 @@ namespace CrossSocket
 	 */
 	void Socket::Send(const char *buf, int len, int flags, const sockaddr *to, int tolen)
 	{
+		// A datagram cannot be queued in part, so one the send limit cannot cover yet is dropped, as a policer would
+		if (!mSendLimit.TryConsume(static_cast<uint64_t>(len)))
+		{
+			if (!mSendHeld)
+			{
+				++mSendThrottled; // Count the hold once, not every datagram it drops
+				mSendHeld = true;
+			}
+			return;
+		}
+		mSendHeld = false;
 		if (sendto(mSocket, buf, len, flags, to, tolen) == SOCKET_ERROR)
 		{
 			Error("SendTo failed with error", CSERROR);
 		}
+		mBytesSent += static_cast<uint64_t>(len);
 	}
 
 	/**
@@ -308,17 +515,23 @@ namespace CrossSocket
 	 * @param buf Destination to store data
 	 * @param len Size (in bytes) of the data received
 	 * @param flags Receiving flags
-	 * @return Data size in bytes
+	 * @return Data size in bytes, or SOCKET_ERROR if the read budget (see IsBudgetExhausted()) or the receive limit (see IsThrottled()) holds the read back. The connection is still open
 	 */
 	int Socket::Receive(char *buf, int len, int flags)
 	{
+		mReceiveTimestamp = 0;
+		if (!TakeReadBudget(len, true))
+		{
+			return SOCKET_ERROR; // Never 0, which would look like the peer closing. The SocketManager calls back again next tick
+		}
+
 		int bytesReceived = 0;
 		while (bytesReceived < len)
 		{
-			int received = recv(mSocket, buf + bytesReceived, len - bytesReceived, flags);
+			int received = ReceiveChunk(buf + bytesReceived, len - bytesReceived, flags, nullptr, nullptr);
 			if (received == 0)
 			{
-				return bytesReceived;
+				break;
 			}
 			else if (received == SOCKET_ERROR)
 			{
@@ -327,17 +540,18 @@ namespace CrossSocket
 				{
 					if (error == CSECONNRESET)
 					{
-						std::cerr << "Connection reset" << std::endl;
+						CS_LOG_WARNING("Connection reset");
 					}
 					else
 					{
 						Error("Recv failed with error", error);
 					}
 				}
-				return bytesReceived;
+				break;
 			}
 			bytesReceived += received;
 		}
+		ChargeReceived(bytesReceived);
 		return bytesReceived;
 	}
 
@@ -349,18 +563,759 @@ namespace CrossSocket
 	 * @param flags Receiving flags
 	 * @param from Source address
 	 * @param fromlen Size (in bytes) of the source address
-	 * @return Data size in bytes
+	 * @return Data size in bytes, or SOCKET_ERROR if the read budget (see IsBudgetExhausted()) or the receive limit (see IsThrottled()) holds the read back. The connection is still open
 	 */
 	int Socket::Receive(char *buf, int len, int flags, sockaddr *from, int *fromlen)
 	{
-		int bytesReceived = recvfrom(mSocket, buf, len, flags, from, fromlen);
+		mReceiveTimestamp = 0;
+		if (!TakeReadBudget(len, false))
+		{
+			return SOCKET_ERROR;
+		}
+
+		int bytesReceived = ReceiveChunk(buf, len, flags, from, fromlen);
 		if (bytesReceived == SOCKET_ERROR)
 		{
 			Error("RecvFrom failed with error", CSERROR);
 		}
+		ChargeReceived(bytesReceived);
 		return bytesReceived;
 	}
 
+	/**
+	 * @brief Receive data through a TCP connection along with when the kernel received it
+	 *
+	 * @param buf Destination to store data
+	 * @param len Size (in bytes) of the data received
+	 * @param flags Receiving flags
+	 * @param timestamp Set to the kernel arrival time in nanoseconds since the Unix epoch (0 if timestamps are not enabled)
+	 * @return Data size in bytes, or SOCKET_ERROR if the read budget (see IsBudgetExhausted()) or the receive limit (see IsThrottled()) holds the read back. The connection is still open
+	 */
+	int Socket::Receive(char *buf, int len, int flags, uint64_t &timestamp)
+	{
+		int bytesReceived = Receive(buf, len, flags);
+		timestamp = mReceiveTimestamp;
+		return bytesReceived;
+	}
+
+	/**
+	 * @brief Receive data through a UDP connection along with when the kernel received it
+	 *
+	 * @param buf Destination to store data
+	 * @param len Size (in bytes) of the data received
+	 * @param flags Receiving flags
+	 * @param from Source address
+	 * @param fromlen Size (in bytes) of the source address
+	 * @param timestamp Set to the kernel arrival time in nanoseconds since the Unix epoch (0 if timestamps are not enabled)
+	 * @return Data size in bytes, or SOCKET_ERROR if the read budget (see IsBudgetExhausted()) or the receive limit (see IsThrottled()) holds the read back. The connection is still open
+	 */
+	int Socket::Receive(char *buf, int len, int flags, sockaddr *from, int *fromlen, uint64_t &timestamp)
+	{
+		int bytesReceived = Receive(buf, len, flags, from, fromlen);
+		timestamp = mReceiveTimestamp;
+		return bytesReceived;
+	}
+
+#ifdef __linux__
+	/**
+	 * @brief Pull the software timestamp out of a received message's control data
+	 *
+	 * @param msg Message filled in by recvmsg()
+	 * @return Nanoseconds since the Unix epoch. 0 if the message carried no timestamp
+	 */
+	static uint64_t ControlTimestamp(msghdr &msg)
+	{
+		for (cmsghdr *cmsg = CMSG_FIRSTHDR(&msg); cmsg != nullptr; cmsg = CMSG_NXTHDR(&msg, cmsg))
+		{
+			if (cmsg->cmsg_level != SOL_SOCKET)
+			{
+				continue;
+			}
+			timespec ts{};
+			if (cmsg->cmsg_type == SCM_TIMESTAMPING)
+			{
+				std::memcpy(&ts, CMSG_DATA(cmsg), sizeof(ts)); // The first of the three is the software timestamp
+			}
+			else if (cmsg->cmsg_type == SCM_TIMESTAMPNS)
+			{
+				std::memcpy(&ts, CMSG_DATA(cmsg), sizeof(ts));
+			}
+			else
+			{
+				continue;
+			}
+			return static_cast<uint64_t>(ts.tv_sec) * 1000000000ull + static_cast<uint64_t>(ts.tv_nsec);
+		}
+		return 0;
+	}
+#endif // __linux__
+
+	/**
+	 * @brief Make one receive call, collecting the arrival timestamp when timestamps are enabled
+	 *
+	 * @param buf Destination to store data
+	 * @param len Size (in bytes) of the buffer
+	 * @param flags Receiving flags
+	 * @param from Source address (nullptr for connected Sockets)
+	 * @param fromlen Size (in bytes) of the source address
+	 * @return Data size in bytes, or SOCKET_ERROR
+	 */
+	int Socket::ReceiveChunk(char *buf, int len, int flags, sockaddr *from, int *fromlen)
+	{
+#ifdef __linux__
+		if (mReceiveTimestamps)
+		{
+			iovec iov{buf, static_cast<size_t>(len)};
+			alignas(cmsghdr) char control[256];
+			msghdr msg{};
+			msg.msg_name = from;
+			msg.msg_namelen = fromlen != nullptr ? static_cast<socklen_t>(*fromlen) : 0;
+			msg.msg_iov = &iov;
+			msg.msg_iovlen = 1;
+			msg.msg_control = control;
+			msg.msg_controllen = sizeof(control);
+
+			int received = static_cast<int>(recvmsg(mSocket, &msg, flags));
+			if (received >= 0)
+			{
+				if (fromlen != nullptr)
+				{
+					*fromlen = static_cast<int>(msg.msg_namelen);
+				}
+				uint64_t timestamp = ControlTimestamp(msg);
+				if (mReceiveTimestamp == 0)
+				{
+					mReceiveTimestamp = timestamp;
+				}
+				if (mFirstArrival == 0)
+				{
+					mFirstArrival = timestamp;
+				}
+			}
+			return received;
+		}
+#endif // __linux__
+
+		if (from != nullptr)
+		{
+#ifdef _WIN32
+			return recvfrom(mSocket, buf, len, flags, from, fromlen);
+#else
+			return recvfrom(mSocket, buf, len, flags, from, reinterpret_cast<socklen_t *>(fromlen));
+#endif // _WIN32
+		}
+		return recv(mSocket, buf, len, flags);
+	}
+
+	/**
+	 * @brief Turn kernel software timestamps on or off (SO_TIMESTAMPING, falling back to SO_TIMESTAMPNS for receive only. Linux only)
+	 *
+	 * @param receive True to timestamp received data
+	 * @param send True to timestamp send completions
+	 * @return True if the kernel accepted the settings. False if it did not or the platform does not support them
+	 */
+	bool Socket::EnableTimestamps(bool receive, bool send)
+	{
+#ifdef __linux__
+		int options = 0;
+		if (receive)
+		{
+			options |= SOF_TIMESTAMPING_RX_SOFTWARE | SOF_TIMESTAMPING_SOFTWARE;
+		}
+		if (send)
+		{
+			// OPT_ID tags each completion so it can be matched to its send, and OPT_TSONLY keeps the data from being looped back
+			options |= SOF_TIMESTAMPING_TX_SOFTWARE | SOF_TIMESTAMPING_SOFTWARE | SOF_TIMESTAMPING_OPT_ID | SOF_TIMESTAMPING_OPT_TSONLY;
+		}
+
+		bool applied = setsockopt(mSocket, SOL_SOCKET, SO_TIMESTAMPING, &options, sizeof(options)) == 0;
+		if (!applied && !send)
+		{
+			int enable = receive ? 1 : 0;
+			applied = setsockopt(mSocket, SOL_SOCKET, SO_TIMESTAMPNS, &enable, sizeof(enable)) == 0;
+		}
+		if (applied)
+		{
+			mReceiveTimestamps = receive;
+			mSendTimestamps = send;
+			if (!send)
+			{
+				mSendCompletions.clear();
+			}
+		}
+		return applied;
+#else
+		(void)receive;
+		(void)send;
+		return false;
+#endif // __linux__
+	}
+
+	/**
+	 * @brief Move every send timestamp waiting in the kernel error queue into mSendCompletions
+	 */
+	void Socket::ReadSendTimestamps()
+	{
+#ifdef __linux__
+		while (true)
+		{
+			alignas(cmsghdr) char control[256];
+			msghdr msg{};
+			msg.msg_control = control;
+			msg.msg_controllen = sizeof(control);
+			if (recvmsg(mSocket, &msg, MSG_ERRQUEUE | MSG_DONTWAIT) < 0)
+			{
+				return;
+			}
+
+			uint64_t timestamp = ControlTimestamp(msg);
+			const sock_extended_err *error = nullptr;
+			for (cmsghdr *cmsg = CMSG_FIRSTHDR(&msg); cmsg != nullptr; cmsg = CMSG_NXTHDR(&msg, cmsg))
+			{
+				if ((cmsg->cmsg_level == IPPROTO_IP && cmsg->cmsg_type == IP_RECVERR) ||
+					(cmsg->cmsg_level == IPPROTO_IPV6 && cmsg->cmsg_type == IPV6_RECVERR))
+				{
+					error = reinterpret_cast<const sock_extended_err *>(CMSG_DATA(cmsg));
+				}
+			}
+			if (error == nullptr || error->ee_errno != ENOMSG || error->ee_origin != SO_EE_ORIGIN_TIMESTAMPING || timestamp == 0)
+			{
+				continue;
+			}
+
+			if (mSendCompletions.size() >= MaxSendTimestamps)
+			{
+				mSendCompletions.pop_front();
+			}
+			mSendCompletions.push_back(SendTimestamp{error->ee_data, timestamp});
+		}
+#endif // __linux__
+	}
+
+	/**
+	 * @brief Get the oldest send timestamp not yet returned
+	 *
+	 * @param completion Set to the send timestamp
+	 * @return True if a timestamp was returned. False if none are waiting
+	 */
+	bool Socket::NextSendTimestamp(SendTimestamp &completion)
+	{
+		if (mSendTimestamps)
+		{
+			ReadSendTimestamps();
+		}
+		if (mSendCompletions.empty())
+		{
+			return false;
+		}
+		completion = mSendCompletions.front();
+		mSendCompletions.pop_front();
+		return true;
+	}
+
+	/**
+	 * @brief Charge one read against the receive budget
+	 *
+	 * @param len Requested read size. Reduced to the remaining byte budget when capLength is true
+	 * @param capLength True to shorten the read to fit the byte budget (streams). False to leave it whole (datagrams)
+	 * @return True if the read may go ahead. False if the budget for this tick or the receive limit is used up
+	 */
+	bool Socket::TakeReadBudget(int &len, bool capLength)
+	{
+		if (mReadBudget == 0 || mByteBudget == 0)
+		{
+			mBudgetExhausted = true;
+			return false;
+		}
+
+		// Checked before charging the budget, so a read the limit refuses does not use one up
+		uint64_t allowance = mReceiveLimit.Available();
+		if (allowance == 0)
+		{
+			if (!mReceiveHeld)
+			{
+				++mReceiveThrottled; // Count the hold once, not every read it refuses
+				mReceiveHeld = true;
+			}
+			return false;
+		}
+		mReceiveHeld = false;
+
+		if (mReadBudget > 0)
+		{
+			--mReadBudget;
+		}
+		if (capLength && mByteBudget > 0 && len > mByteBudget)
+		{
+			len = mByteBudget;
+		}
+		if (capLength && static_cast<uint64_t>(len) > allowance)
+		{
+			len = static_cast<int>(allowance);
+		}
+		return true;
+	}
+
+	/**
+	 * @brief Charge received bytes against the per-tick budget and the receive limit
+	 *
+	 * @param received Number of bytes received
+	 */
+	void Socket::ChargeReceived(int received)
+	{
+		if (received <= 0)
+		{
+			return;
+		}
+		mBytesReceived += static_cast<uint64_t>(received);
+		mReceiveLimit.Consume(static_cast<uint64_t>(received));
+		if (mByteBudget > 0)
+		{
+			mByteBudget = received < mByteBudget ? mByteBudget - received : 0;
+		}
+	}
+
+	/**
+	 * @brief Start a length-prefixed message in the Socket's send buffer
+	 *
+	 * Until SendMessage(), Flush() only sends what was queued before the message, so a half-written frame never goes out.
+	 * Only one message may be open at a time. Throws if one already is
+	 *
+	 * @return Writer that appends fields directly into the send buffer
+	 */
+	MessageWriter Socket::BeginMessage()
+	{
+		if (mOpenMessage != NoMessage)
+		{
+			throw std::runtime_error("BeginMessage() called while another message is open. Finish it with SendMessage() first");
+		}
+		MessageWriter message(mSendBuffer);
+		message.ReserveU32(); // Frame length, filled in by SendMessage()
+		mOpenMessage = message.Offset();
+		return message;
+	}
+
+	/**
+	 * @brief Finish a message from BeginMessage() and try to send everything queued
+	 *
+	 * @param message Writer returned by BeginMessage(). Only one message may be open at a time
+	 * @param flags Sending flags
+	 * @return True if the send buffer is now empty. False if a nonblocking Socket could not take all of it (call Flush() when writable)
+	 */
+	bool Socket::SendMessage(MessageWriter &message, int flags)
+	{
+		if (mOpenMessage != message.Offset())
+		{
+			throw std::runtime_error("SendMessage() needs the message from the last BeginMessage(), and the Socket must not have been closed since");
+		}
+		message.EndSection(message.Offset());
+		mOpenMessage = NoMessage;
+		if (!mSendQueue.empty())
+		{
+			MoveSendBufferToQueue(); // Shared payloads are ahead of this message, so it has to wait behind them
+		}
+		return Flush(flags);
+	}
+
+	/**
+	 * @brief Send as much of the queued output as the Socket will take
+	 *
+	 * @param flags Sending flags
+	 * @return True if the send buffer is now empty
+	 */
+	bool Socket::Flush(int flags)
+	{
+		uint64_t sent;
+		int error;
+		bool flushed = FlushUpTo(flags, std::numeric_limits<uint64_t>::max(), sent, error);
+		if (error != 0)
+		{
+			Error("Send failed with error", error);
+		}
+		return flushed;
+	}
+
+	/**
+	 * @brief Send queued output, stopping at the send limit or an extra byte limit
+	 *
+	 * @param flags Sending flags
+	 * @param limit Most bytes to send, on top of the Socket's own send limit
+	 * @param sent Set to the number of bytes sent
+	 * @param error Set to the error code if sending failed, otherwise 0. The Socket is left open for the caller to deal with
+	 * @return True if all queued output has been sent
+	 */
+	bool Socket::FlushUpTo(int flags, uint64_t limit, uint64_t &sent, int &error)
+	{
+		sent = 0;
+		error = 0;
+		uint64_t own = mSendLimit.Available();
+		uint64_t allowance = own < limit ? own : limit;
+		if (own > 0)
+		{
+			mSendHeld = false;
+		}
+
+		while (PendingSendBytes() > 0)
+		{
+			if (allowance == 0)
+			{
+				if (sent == own && !mSendHeld) // The Socket's own limit ran dry, not the caller's. Count the hold once
+				{
+					++mSendThrottled;
+					mSendHeld = true;
+				}
+				return false;
+			}
+
+			// Shared payloads go out before the send buffer, since finished messages only stay in the buffer while the queue is empty
+			const char *data;
+			size_t remaining;
+			if (!mSendQueue.empty() && mSendQueue.front().payload)
+			{
+				data = mSendQueue.front().payload->data() + mSendQueue.front().offset;
+				remaining = mSendQueue.front().payload->size() - mSendQueue.front().offset;
+			}
+			else if (!mSendQueue.empty())
+			{
+				data = mSendBuffer.Data(); // Earlier ranges have been consumed, so this one starts at the front of the buffer
+				remaining = mSendQueue.front().end - mSendBuffer.StartOffset();
+			}
+			else
+			{
+				data = mSendBuffer.Data();
+				remaining = FinishedSendBytes();
+			}
+
+			size_t chunk = remaining > 0x40000000 ? 0x40000000 : remaining;
+			if (chunk > allowance)
+			{
+				chunk = static_cast<size_t>(allowance);
+			}
+			int result = send(mSocket, data, static_cast<int>(chunk), flags);
+			if (result == SOCKET_ERROR)
+			{
+				error = CSERROR;
+				if (error == CSEWOULDBLOCK)
+				{
+					error = 0;
+				}
+				return false;
+			}
+
+			size_t moved = static_cast<size_t>(result);
+			sent += moved;
+			allowance -= moved;
+			mBytesSent += moved;
+			mSendLimit.Consume(moved);
+
+			if (!mSendQueue.empty() && mSendQueue.front().payload)
+			{
+				QueuedPayload &head = mSendQueue.front();
+				head.offset += moved;
+				mQueuedBytes -= moved;
+				if (head.offset == head.payload->size())
+				{
+					mSendQueue.pop_front(); // Drops this Socket's reference. The last Socket to get here frees the payload
+				}
+			}
+			else
+			{
+				mSendBuffer.Consume(moved);
+				if (!mSendQueue.empty() && mSendBuffer.StartOffset() == mSendQueue.front().end)
+				{
+					mSendQueue.pop_front();
+				}
+			}
+		}
+		return true;
+	}
+
+	/**
+	 * @brief Limit how fast queued output is sent. Bytes over the limit wait in the send queue for Flush() or the SocketManager
+	 *
+	 * @param bytesPerSecond Sustained rate. 0 removes the limit
+	 * @param burstBytes Largest burst allowed after an idle period. 0 picks 100 ms worth of the rate
+	 */
+	void Socket::SetSendRateLimit(uint64_t bytesPerSecond, uint64_t burstBytes)
+	{
+		mSendLimit.SetRate(bytesPerSecond, burstBytes);
+	}
+
+	/**
+	 * @brief Limit how fast data is received. Once the limit runs dry, Receive() returns SOCKET_ERROR and IsThrottled() returns true until it refills
+	 *
+	 * @param bytesPerSecond Sustained rate. 0 removes the limit
+	 * @param burstBytes Largest burst allowed after an idle period. 0 picks 100 ms worth of the rate
+	 */
+	void Socket::SetReceiveRateLimit(uint64_t bytesPerSecond, uint64_t burstBytes)
+	{
+		mReceiveLimit.SetRate(bytesPerSecond, burstBytes);
+	}
+
+	/**
+	 * @brief Ask the kernel to pace outgoing packets (SO_MAX_PACING_RATE, Linux only)
+	 *
+	 * @param bytesPerSecond Pacing rate. 0 removes the limit
+	 * @return True if the option was applied. False if the platform does not support it
+	 */
+	bool Socket::SetPacingRate(uint64_t bytesPerSecond)
+	{
+#if defined(__linux__) && defined(SO_MAX_PACING_RATE)
+		if (bytesPerSecond == 0)
+		{
+			bytesPerSecond = std::numeric_limits<uint64_t>::max(); // The kernel treats all ones as no limit
+		}
+		if (bytesPerSecond >= 0xFFFFFFFFull) // Older kernels only take a 32-bit value
+		{
+			uint64_t rate = bytesPerSecond;
+			if (setsockopt(mSocket, SOL_SOCKET, SO_MAX_PACING_RATE, &rate, sizeof(rate)) == 0)
+			{
+				return true;
+			}
+			uint32_t rate32 = 0xFFFFFFFFu;
+			return setsockopt(mSocket, SOL_SOCKET, SO_MAX_PACING_RATE, &rate32, sizeof(rate32)) == 0;
+		}
+		uint32_t rate = static_cast<uint32_t>(bytesPerSecond);
+		return setsockopt(mSocket, SOL_SOCKET, SO_MAX_PACING_RATE, &rate, sizeof(rate)) == 0;
+#else
+		(void)bytesPerSecond;
+		return false;
+#endif
+	}
+
+	/**
+	 * @brief Get the traffic counters and rate limits of the Socket
+	 *
+	 * @return Rate statistics
+	 */
+	RateStats Socket::GetRateStats() const
+	{
+		return RateStats{mBytesSent, mBytesReceived, mSendThrottled, mReceiveThrottled, mSendLimit.GetRate(), mReceiveLimit.GetRate()};
+	}
+
+	/**
+	 * @brief Return how long until the send limit allows another packet
+	 *
+	 * @return Time in milliseconds (0 if a packet may be sent now)
+	 */
+	int Socket::MillisUntilSendAllowed()
+	{
+		return mSendLimit.IsLimited() ? mSendLimit.MillisUntilAvailable() : 0;
+	}
+
+	/**
+	 * @brief Return how long until the receive limit allows another packet
+	 *
+	 * @return Time in milliseconds (0 if a packet may be received now)
+	 */
+	int Socket::MillisUntilReceiveAllowed()
+	{
+		return mReceiveLimit.IsLimited() ? mReceiveLimit.MillisUntilAvailable() : 0;
+	}
+
+	/**
+	 * @brief Return the number of bytes waiting to be sent, including queued shared payloads
+	 *
+	 * @return Size in bytes
+	 */
+	size_t Socket::PendingSendBytes() const
+	{
+		return mQueuedBytes + FinishedSendBytes();
+	}
+
+	/**
+	 * @brief Return the bytes at the front of the send buffer that belong to finished messages or plain sends
+	 *
+	 * @return Size in bytes. Everything from an open message onwards is held back until SendMessage()
+	 */
+	size_t Socket::FinishedSendBytes() const
+	{
+		return mOpenMessage == NoMessage ? mSendBuffer.Size() : mOpenMessage - mSendBuffer.StartOffset();
+	}
+
+	/**
+	 * @brief Queue a reference to a payload behind everything already waiting to be sent
+	 *
+	 * @param payload Payload to queue
+	 * @param broadcast True if the payload comes from SocketManager::Broadcast()
+	 */
+	void Socket::QueuePayload(const SharedPayload &payload, bool broadcast)
+	{
+		MoveSendBufferToQueue();
+		mSendQueue.push_back(QueuedPayload{payload, 0, 0, broadcast});
+		mQueuedBytes += payload->size();
+	}
+
+	/**
+	 * @brief Drop every queued broadcast payload that has not started sending. The Socket's own messages are kept
+	 *
+	 * @return Number of payloads dropped
+	 */
+	size_t Socket::DropUnsentPayloads()
+	{
+		auto first = mSendQueue.begin();
+		if (first != mSendQueue.end() && first->offset > 0)
+		{
+			++first; // Half-sent payloads must finish or the peer would see a torn message
+		}
+
+		size_t dropped = 0;
+		auto kept = first;
+		for (auto it = first; it != mSendQueue.end(); ++it)
+		{
+			if (it->broadcast) // Only shared payloads are broadcast, so ranges of the send buffer are always kept
+			{
+				mQueuedBytes -= it->payload->size();
+				++dropped;
+			}
+			else
+			{
+				*kept++ = std::move(*it);
+			}
+		}
+		mSendQueue.erase(kept, mSendQueue.end());
+		return dropped;
+	}
+
+	/**
+	 * @brief Queue the finished messages in the send buffer that are not queued yet, as a range that references the buffer.
+	 * Nothing is copied, and an open message stays out of the queue
+	 */
+	void Socket::MoveSendBufferToQueue()
+	{
+		size_t start = mQueuedBufferEnd > mSendBuffer.StartOffset() ? mQueuedBufferEnd : mSendBuffer.StartOffset();
+		size_t end = mSendBuffer.StartOffset() + FinishedSendBytes();
+		if (end == start)
+		{
+			return;
+		}
+		if (!mSendQueue.empty() && !mSendQueue.back().payload)
+		{
+			mSendQueue.back().end = end; // Nothing was queued after the last range, so it can just grow
+		}
+		else
+		{
+			mSendQueue.push_back(QueuedPayload{nullptr, 0, end, false});
+		}
+		mQueuedBufferEnd = end;
+	}
+
+	/**
+	 * @brief Receive the next length-prefixed message into the Socket's receive buffer
+	 *
+	 * @param message Set to a reader over the message. It reads straight from the receive buffer and is valid until the next call
+	 * @param flags Receiving flags
+	 * @return True if a whole message was received. False if a nonblocking Socket has no whole message yet, the read budget is used up, or the peer closed the connection
+	 */
+	bool Socket::ReceiveMessage(MessageReader &message, int flags)
+	{
+		if (mReceivedMessage > 0)
+		{
+			mReceiveBuffer.Consume(mReceivedMessage);
+			mReceivedMessage = 0;
+		}
+
+		while (true)
+		{
+			size_t wanted = 65536;
+			if (mReceiveBuffer.Size() >= sizeof(uint32_t))
+			{
+				uint32_t length;
+				std::memcpy(&length, mReceiveBuffer.Data(), sizeof(length));
+				length = CS_Utils::cs_ntohl(length);
+				if (length > MaxMessageSize)
+				{
+					Error("Message exceeded the size limit with length", static_cast<int>(length > 0x7FFFFFFF ? 0x7FFFFFFF : length));
+				}
+
+				size_t frame = sizeof(uint32_t) + length;
+				if (mReceiveBuffer.Size() >= frame)
+				{
+					message = MessageReader(mReceiveBuffer.Data() + sizeof(uint32_t), length);
+					mReceivedMessage = frame;
+					return true;
+				}
+				if (frame - mReceiveBuffer.Size() > wanted)
+				{
+					wanted = frame - mReceiveBuffer.Size(); // Make room for the whole message at once
+				}
+			}
+
+			if (mPeerClosed)
+			{
+				return false;
+			}
+
+			// Read straight into the receive buffer so the message is never copied again
+			char *space = mReceiveBuffer.Reserve(wanted);
+			size_t available = mReceiveBuffer.Available();
+			int len = static_cast<int>(available > 0x40000000 ? 0x40000000 : available);
+			if (!TakeReadBudget(len, true))
+			{
+				return false;
+			}
+
+			int received = ReceiveChunk(space, len, flags, nullptr, nullptr);
+			if (received == 0)
+			{
+				mPeerClosed = true;
+				return false;
+			}
+			else if (received == SOCKET_ERROR)
+			{
+				int error = CSERROR;
+				if (error == CSEWOULDBLOCK || error == CSEINPROGRESS || error == CSEALREADY)
+				{
+					return false;
+				}
+				if (error == CSECONNRESET)
+				{
+					CS_LOG_WARNING("Connection reset");
+					mPeerClosed = true;
+					return false;
+				}
+				Error("Recv failed with error", error);
+			}
+
+			mReceiveBuffer.Commit(static_cast<size_t>(received));
+			ChargeReceived(received);
+		}
+	}
+
+	/**
+	 * @brief Check if the SocketManager's read budget stopped a receive in the current onRead callback
+	 *
+	 * The connection is still healthy. The SocketManager calls back again next tick to read the rest
+	 *
+	 * @return True if a Receive() or ReceiveMessage() call was refused for this tick
+	 */
+	bool Socket::IsBudgetExhausted() const
+	{
+		return mBudgetExhausted;
+	}
+
+	/**
+	 * @brief Check if the receive limit (see SetReceiveRateLimit()) refused the last Receive() or ReceiveMessage() call
+	 *
+	 * The connection is still healthy. Reads go ahead again once the limit refills
+	 *
+	 * @return True while the receive limit is holding reads back
+	 */
+	bool Socket::IsThrottled() const
+	{
+		return mReceiveHeld;
+	}
+
+	/**
+	 * @brief Check if ReceiveMessage() has seen the peer close the connection
+	 *
+	 * @return True if the connection is closed for reading
+	 */
+	bool Socket::IsPeerClosed() const
+	{
+		return mPeerClosed;
+	}
+
 	/**
 	 * @brief Return the unwrapped socket
 	 *
@@ -1,12 +1,39 @@
 #include "CrossSocket/SocketManager.h"
+#include "CrossSocket/Log.h"
 
+#include <algorithm>
+#include <chrono>
+#include <cerrno>
+#include <climits>
+#include <limits>
 #include <string>
 #include <stdexcept>
 
+#ifdef __linux__
+#include <csignal>
+#include <pthread.h>
+#endif // __linux__
+
 namespace CrossSocket
 {
+#ifdef MSG_NOSIGNAL
+    static const int OutputFlags = MSG_NOSIGNAL; // A subscriber hanging up must not raise SIGPIPE in the event loop
+#else
+    static const int OutputFlags = 0;
+#endif // MSG_NOSIGNAL
+
     SocketManager *SocketManager::sInstance = nullptr;
 
+    /**
+     * @brief Read the clock kernel timestamps use
+     *
+     * @return Nanoseconds since the Unix epoch
+     */
+    static uint64_t RealtimeNanos()
+    {
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count());
+    }
+
     /**
      * @brief Get SocketManager Singleton object
      *
@@ -35,6 +62,7 @@ namespace CrossSocket
      * @brief SocketManager initialization. Private in order to ensure Singleton
      */
     SocketManager::SocketManager()
+        : broadcastStats{}, rateStats{}, dispatchStart(0), latencyObserver(nullptr), wakeupTime(0), lowLatency(false), spinBudgetMicros(0), loopStats{}
     {
         CS_Utils::Initialize();
     }
@@ -51,30 +79,321 @@ namespace CrossSocket
      */
     int SocketManager::AddSocket(Socket &socket, bool monitorRead, bool monitorWrite, void (*onRead)(Socket &), void (*onWrite)(Socket &))
     {
-        sockets.push_back(WatchedSocket{&socket, (int)sockets.size(), monitorRead, monitorWrite, onRead, onWrite});
+        sockets.push_back(WatchedSocket{&socket, (int)sockets.size(), monitorRead, monitorWrite, onRead, onWrite, false, false, LagPolicy::Drop, 0, false, false, false});
+        if (lowLatency && lowLatencyConfig.busyPollMicros > 0)
+        {
+            socket.SetBusyPoll(lowLatencyConfig.busyPollMicros, lowLatencyConfig.preferBusyPoll);
+        }
         return static_cast<int>(sockets.size()) - 1;
     }
 
+#ifdef __linux__
+    /**
+     * @brief Add a SharedRing to the SocketManager event loop
+     *
+     * @param ring Connected SharedRing to add
+     * @param onRead Function pointer to callback upon data receiving (must take SharedRing& as only parameter)
+     * @return SharedRing ID in vector
+     */
+    int SocketManager::AddSharedRing(SharedRing &ring, void (*onRead)(SharedRing &))
+    {
+        rings.push_back(WatchedRing{&ring, (int)rings.size(), onRead});
+        return static_cast<int>(rings.size()) - 1;
+    }
+
+    /**
+     * @brief Remove a SharedRing from the event loop
+     *
+     * @param id SharedRing ID to remove
+     */
+    void SocketManager::CloseSharedRing(int id)
+    {
+        rings[id].ring->Close();
+        for (size_t i = static_cast<size_t>(id); i < rings.size(); ++i)
+        {
+            --rings[i].id;
+        }
+        rings.erase(rings.begin() + id);
+    }
+
+    /**
+     * @brief Relay data between two connected Sockets in both directions without copying it through user space
+     *
+     * @param first First Socket
+     * @param second Second Socket
+     * @param onClosed Function pointer to callback once both directions have finished or failed (must take Socket&, Socket&). The relay is already removed when it runs
+     * @return Relay ID in vector
+     */
+    int SocketManager::AddRelay(Socket &first, Socket &second, void (*onClosed)(Socket &, Socket &))
+    {
+        WatchedRelay relay{(int)relays.size(), {}, 0, false, onClosed};
+        relay.directions[0] = RelayDirection{&first, &second, -1, -1, 0, false, false, false, 0};
+        relay.directions[1] = RelayDirection{&second, &first, -1, -1, 0, false, false, false, 0};
+
+        for (RelayDirection &direction : relay.directions)
+        {
+            int fds[2];
+            if (pipe2(fds, O_NONBLOCK | O_CLOEXEC) == -1)
+            {
+                int error = errno;
+                ReleaseRelay(relay);
+                throw std::runtime_error("pipe2() failed for relay " + std::to_string(error));
+            }
+            direction.pipeRead = fds[0];
+            direction.pipeWrite = fds[1];
+
+            // A bigger pipe lets each splice() move more at once. Failing to grow it is not an error
+            fcntl(fds[1], F_SETPIPE_SZ, 256 * 1024);
+            int size = fcntl(fds[1], F_GETPIPE_SZ);
+            relay.pipeCapacity = size > 0 ? static_cast<size_t>(size) : 65536;
+        }
+
+        first.SetNonblockingMode(true);
+        second.SetNonblockingMode(true);
+
+        relays.push_back(relay);
+        return static_cast<int>(relays.size()) - 1;
+    }
+
+    /**
+     * @brief Remove a relay from the event loop and close both of its Sockets
+     *
+     * @param id Relay ID to remove
+     */
+    void SocketManager::CloseRelay(int id)
+    {
+        ReleaseRelay(relays[id]);
+        relays[id].directions[0].from->Close();
+        relays[id].directions[1].from->Close();
+        for (size_t i = static_cast<size_t>(id); i < relays.size(); ++i)
+        {
+            --relays[i].id;
+        }
+        relays.erase(relays.begin() + id);
+    }
+
+    /**
+     * @brief Get the number of bytes a relay has delivered in each direction
+     *
+     * @param id Relay ID
+     * @param firstToSecond Bytes delivered from the first Socket to the second
+     * @param secondToFirst Bytes delivered from the second Socket to the first
+     */
+    void SocketManager::GetRelayBytes(int id, uint64_t &firstToSecond, uint64_t &secondToFirst) const
+    {
+        firstToSecond = relays[id].directions[0].bytes;
+        secondToFirst = relays[id].directions[1].bytes;
+    }
+
+    /**
+     * @brief splice() from a pipe into a Socket without raising SIGPIPE. splice() has no MSG_NOSIGNAL, so the signal is blocked instead
+     *
+     * @param pipeRead Read end of the pipe
+     * @param socket Socket to write to
+     * @param len Number of bytes to move
+     * @return Bytes moved, or -1 with errno set. A peer that hung up gives EPIPE
+     */
+    static ssize_t SpliceToSocket(int pipeRead, socket_t socket, size_t len)
+    {
+        sigset_t pipeSignal, previous;
+        sigemptyset(&pipeSignal);
+        sigaddset(&pipeSignal, SIGPIPE);
+        pthread_sigmask(SIG_BLOCK, &pipeSignal, &previous);
+
+        ssize_t moved = splice(pipeRead, nullptr, socket, nullptr, len, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+        int error = errno;
+        if (moved == -1 && error == EPIPE && !sigismember(&previous, SIGPIPE))
+        {
+            // Take the signal this splice() raised so it is not delivered once SIGPIPE is unblocked
+            timespec noWait{0, 0};
+            sigtimedwait(&pipeSignal, nullptr, &noWait);
+        }
+
+        pthread_sigmask(SIG_SETMASK, &previous, nullptr);
+        errno = error;
+        return moved;
+    }
+
+    /**
+     * @brief Move data through one direction of a relay
+     *
+     * @param direction Direction to move
+     * @param pipeCapacity Size (in bytes) of the direction's pipe
+     * @param readable True if select() reported the source as readable
+     * @param failed Set to true if either Socket failed
+     * @return True if any data moved or the direction changed state. False if nothing happened or an error occurred
+     */
+    bool SocketManager::PumpRelay(RelayDirection &direction, size_t pipeCapacity, bool readable, bool &failed)
+    {
+        bool progress = false;
+
+        if (readable && !direction.eof && !direction.pipeFull && direction.buffered < pipeCapacity)
+        {
+            ssize_t moved = splice(direction.from->GetRawSocket(), nullptr, direction.pipeWrite, nullptr,
+                                   pipeCapacity - direction.buffered, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+            if (moved > 0)
+            {
+                direction.buffered += static_cast<size_t>(moved);
+                progress = true;
+            }
+            else if (moved == 0)
+            {
+                direction.eof = true;
+                progress = true;
+            }
+            else if (errno == EAGAIN && direction.buffered > 0)
+            {
+                direction.pipeFull = true; // The source stays unwatched until the sink drains some of the pipe
+            }
+            else if (errno != EAGAIN && errno != EINTR)
+            {
+                failed = true;
+                return false;
+            }
+        }
+
+        // Flush right away instead of waiting a tick for write readiness. A full socket buffer just returns EAGAIN
+        if (direction.buffered > 0)
+        {
+            ssize_t moved = SpliceToSocket(direction.pipeRead, direction.to->GetRawSocket(), direction.buffered);
+            if (moved > 0)
+            {
+                direction.buffered -= static_cast<size_t>(moved);
+                direction.bytes += static_cast<uint64_t>(moved);
+                direction.pipeFull = false;
+                progress = true;
+            }
+            else if (moved < 0 && errno != EAGAIN && errno != EINTR)
+            {
+                failed = true; // Includes EPIPE once the sink's peer has hung up
+                return false;
+            }
+        }
+
+        if (direction.eof && direction.buffered == 0 && !direction.shutdownSent)
+        {
+            direction.to->Shutdown(1); // Pass the half-close on so the other side sees end of stream
+            direction.shutdownSent = true;
+            progress = true;
+        }
+        return progress;
+    }
+
+    /**
+     * @brief Close the pipes of a relay
+     *
+     * @param relay Relay to release
+     */
+    void SocketManager::ReleaseRelay(WatchedRelay &relay)
+    {
+        for (RelayDirection &direction : relay.directions)
+        {
+            if (direction.pipeRead != -1)
+            {
+                close(direction.pipeRead);
+                direction.pipeRead = -1;
+            }
+            if (direction.pipeWrite != -1)
+            {
+                close(direction.pipeWrite);
+                direction.pipeWrite = -1;
+            }
+        }
+    }
+#endif // __linux__
+
+    /**
+     * @brief Resolve a host name without blocking the event loop. The callback runs from a later RunOnce()
+     *
+     * @param host Host name or numeric address (names in the local hosts file are honored)
+     * @param port Port to store in every returned address
+     * @param family AF_INET, AF_INET6, or AF_UNSPEC for both
+     * @param onResolved Function pointer to callback with the result (must take const Resolution& and void*)
+     * @param userData Pointer passed back to the callback untouched
+     */
+    void SocketManager::Resolve(const char *host, u_short port, int family, Resolver::Callback onResolved, void *userData)
+    {
+        resolver.Resolve(host, port, family, onResolved, userData);
+    }
+
+    /**
+     * @brief Set how long name lookups stay cached
+     *
+     * @param ttlMillis Time for successful lookups in milliseconds. 0 disables caching
+     * @param negativeTtlMillis Time for failed lookups in milliseconds. 0 disables caching
+     */
+    void SocketManager::SetResolverCacheTTL(int ttlMillis, int negativeTtlMillis)
+    {
+        resolver.SetCacheTTL(ttlMillis, negativeTtlMillis);
+    }
+
     /**
      * @brief Check all watched Sockets for updates
      *
      * @param timeoutMillis Timeout for check in milliseconds
+     * @return Number of callbacks run
      */
-    void SocketManager::RunOnce(int timeoutMillis)
+    int SocketManager::RunOnce(int timeoutMillis)
     {
+        int dispatched = 0;
         fd_set readSet{}, writeSet{};
         FD_ZERO(&readSet);
         FD_ZERO(&writeSet);
         socket_t maxFd = 0;
 
+        // A Socket whose rate limit has run dry is left out of select() and the timeout is cut to when the limit refills
+        int receiveWait = receiveLimit.MillisUntilAvailable();
+        int sendWait = sendLimit.MillisUntilAvailable();
         for (WatchedSocket &ws : sockets)
         {
             socket_t s = ws.socket->GetRawSocket();
             if (ws.monitorRead)
             {
-                FD_SET(s, &readSet);
+                int wait = ws.socket->MillisUntilReceiveAllowed();
+                bool held = !ws.priority && receiveWait > wait;
+                if (held)
+                {
+                    wait = receiveWait;
+                    if (!ws.receiveHeld) // Count each time a Socket starts being held back, not every tick it stays that way
+                    {
+                        ++rateStats.receiveThrottled;
+                    }
+                }
+                ws.receiveHeld = held;
+                if (wait == 0)
+                {
+                    FD_SET(s, &readSet);
+                }
+                else if (wait < timeoutMillis)
+                {
+                    timeoutMillis = wait;
+                }
             }
-            if (ws.monitorWrite)
+            bool sendWaiting = false;
+            if (ws.socket->PendingSendBytes() > 0)
+            {
+                int wait = ws.socket->MillisUntilSendAllowed();
+                bool held = !ws.priority && sendWait > wait;
+                if (held)
+                {
+                    wait = sendWait;
+                    if (!ws.sendHeld)
+                    {
+                        ++rateStats.sendThrottled;
+                    }
+                }
+                ws.sendHeld = held;
+                sendWaiting = wait == 0;
+                if (wait > 0 && wait < timeoutMillis)
+                {
+                    timeoutMillis = wait;
+                }
+            }
+            else
+            {
+                ws.sendHeld = false;
+            }
+            if (ws.monitorWrite || sendWaiting)
             {
                 FD_SET(s, &writeSet);
             }
@@ -84,6 +403,57 @@ namespace CrossSocket
             }
         }
 
+#ifdef __linux__
+        for (WatchedRing &wr : rings)
+        {
+            // Rings only wake the loop through their eventfd while armed. If data is already waiting, poll instead of sleeping
+            if (wr.ring->ArmReadNotify())
+            {
+                timeoutMillis = 0;
+            }
+            socket_t s = wr.ring->GetNotifyHandle();
+            FD_SET(s, &readSet);
+            if (s > maxFd)
+            {
+                maxFd = s;
+            }
+        }
+
+        for (WatchedRelay &relay : relays)
+        {
+            for (RelayDirection &direction : relay.directions)
+            {
+                // Only read while the pipe has room and only wait for write readiness while it holds data, so backpressure reaches the sender
+                if (!direction.eof && !direction.pipeFull && direction.buffered < relay.pipeCapacity)
+                {
+                    socket_t s = direction.from->GetRawSocket();
+                    FD_SET(s, &readSet);
+                    maxFd = s > maxFd ? s : maxFd;
+                }
+                if (direction.buffered > 0)
+                {
+                    socket_t s = direction.to->GetRawSocket();
+                    FD_SET(s, &writeSet);
+                    maxFd = s > maxFd ? s : maxFd;
+                }
+            }
+        }
+#endif // __linux__
+
+        socket_t resolverHandle = resolver.GetNotifyHandle();
+        if (resolverHandle != INVALID_SOCKET)
+        {
+            if (resolver.HasPending())
+            {
+                timeoutMillis = 0;
+            }
+            FD_SET(resolverHandle, &readSet);
+            if (resolverHandle > maxFd)
+            {
+                maxFd = resolverHandle;
+            }
+        }
+
         timeval timeout{};
         timeout.tv_sec = timeoutMillis / 1000;
         timeout.tv_usec = (timeoutMillis % 1000) * 1000;
@@ -93,19 +463,417 @@ namespace CrossSocket
         {
             throw std::runtime_error("select() failed in event loop" + std::to_string(CSERROR));
         }
+        if (latencyObserver)
+        {
+            wakeupTime = RealtimeNanos();
+        }
 
-        for (WatchedSocket &ws : sockets) // Handle event callbacks
+        if (resolverHandle != INVALID_SOCKET && FD_ISSET(resolverHandle, &readSet))
         {
-            socket_t s = ws.socket->GetRawSocket();
-            if (ws.monitorRead && FD_ISSET(s, &readSet) && ws.onRead)
+            dispatched += resolver.Dispatch();
+        }
+
+        // Control-plane Sockets run first and skip the budgets. The rest start from a position that rotates each tick under round-robin.
+        // The order is fixed before any callback runs, since callbacks may close Sockets and shift the ones after them
+        size_t count = sockets.size();
+        dispatchOrder.clear();
+        for (int pass = 0; pass < 2; ++pass)
+        {
+            for (size_t n = 0; n < count; ++n)
             {
-                ws.onRead(*ws.socket); // Run the onRead callback
+                size_t i = pass == 0 ? n : (n + dispatchStart) % count;
+                if (sockets[i].priority == (pass == 0))
+                {
+                    dispatchOrder.push_back(DispatchEntry{sockets[i].socket, i});
+                }
             }
-            if (ws.monitorWrite && FD_ISSET(s, &writeSet) && ws.onWrite)
+        }
+        for (const DispatchEntry &entry : dispatchOrder)
+        {
+            // Closing only moves Sockets to lower indices, so search down from where this one started. Closed Sockets are not found
+            size_t i = entry.index < sockets.size() ? entry.index + 1 : sockets.size();
+            while (i > 0 && sockets[i - 1].socket != entry.socket)
+            {
+                --i;
+            }
+            if (i > 0)
+            {
+                dispatched += DispatchSocket(sockets[i - 1], readSet, writeSet);
+            }
+        }
+        if (dispatchPolicy.roundRobin && count > 0)
+        {
+            dispatchStart = (dispatchStart + 1) % count;
+        }
+
+        for (int i = static_cast<int>(sockets.size()) - 1; i >= 0; --i)
+        {
+            if (sockets[i].failed)
+            {
+                if (sockets[i].subscriber)
+                {
+                    ++broadcastStats.disconnected;
+                }
+                CloseSocket(i);
+            }
+        }
+
+#ifdef __linux__
+        // Like Sockets, rings are dispatched from a snapshot since callbacks may close them
+        ringOrder.clear();
+        for (const WatchedRing &wr : rings)
+        {
+            ringOrder.push_back(wr.ring);
+        }
+        for (size_t n = 0; n < ringOrder.size(); ++n)
+        {
+            size_t i = n < rings.size() ? n + 1 : rings.size();
+            while (i > 0 && rings[i - 1].ring != ringOrder[n])
+            {
+                --i;
+            }
+            if (i == 0)
+            {
+                continue;
+            }
+            SharedRing *ring = rings[i - 1].ring;
+            void (*onRead)(SharedRing &) = rings[i - 1].onRead;
+            ring->DisarmReadNotify();
+            if (onRead && ring->IsReadyToRead())
+            {
+                onRead(*ring);
+                ++dispatched;
+            }
+        }
+
+        std::vector<WatchedRelay> finished;
+        for (size_t i = 0; i < relays.size();)
+        {
+            WatchedRelay &relay = relays[i];
+            for (RelayDirection &direction : relay.directions)
+            {
+                bool readable = FD_ISSET(direction.from->GetRawSocket(), &readSet);
+                bool writable = FD_ISSET(direction.to->GetRawSocket(), &writeSet);
+                if ((readable || writable) && !relay.failed && PumpRelay(direction, relay.pipeCapacity, readable, relay.failed))
+                {
+                    ++dispatched;
+                }
+            }
+
+            if (relay.failed || (relay.directions[0].shutdownSent && relay.directions[1].shutdownSent))
+            {
+                ReleaseRelay(relay);
+                finished.push_back(relay);
+                for (size_t j = i + 1; j < relays.size(); ++j)
+                {
+                    --relays[j].id;
+                }
+                relays.erase(relays.begin() + i);
+            }
+            else
+            {
+                ++i;
+            }
+        }
+        for (WatchedRelay &relay : finished) // Callbacks run after removal so they may add or close relays freely
+        {
+            if (relay.onClosed)
             {
-                ws.onWrite(*ws.socket);
+                relay.onClosed(*relay.directions[0].from, *relay.directions[1].from);
+                ++dispatched;
             }
         }
+#endif // __linux__
+
+        return dispatched;
+    }
+
+    /**
+     * @brief Run the callbacks of one watched Socket, applying the per-tick receive budget
+     *
+     * @param ws Watched Socket
+     * @param readSet Sockets select() reported as readable
+     * @param writeSet Sockets select() reported as writable
+     * @return Number of callbacks run
+     */
+    int SocketManager::DispatchSocket(WatchedSocket &ws, fd_set &readSet, fd_set &writeSet)
+    {
+        int dispatched = 0;
+        Socket *socket = ws.socket; // ws is not safe to touch after a callback, since callbacks may close Sockets
+        bool priority = ws.priority;
+        void (*onWrite)(Socket &) = ws.onWrite;
+        bool writeReady = ws.monitorWrite && FD_ISSET(socket->GetRawSocket(), &writeSet);
+
+        if (socket->PendingSendBytes() > 0 && FD_ISSET(socket->GetRawSocket(), &writeSet))
+        {
+            if (!FlushOutput(ws))
+            {
+                ws.failed = true;
+                return dispatched;
+            }
+            ++dispatched;
+        }
+
+        bool readReady = ws.monitorRead && FD_ISSET(socket->GetRawSocket(), &readSet);
+#ifdef __linux__
+        if (readReady && socket->mSendTimestamps)
+        {
+            // Send timestamps wake select() through the error queue. Only call back if there is more than that to read
+            socket->ReadSendTimestamps();
+            char peek;
+            readReady = !(recv(socket->GetRawSocket(), &peek, 1, MSG_PEEK | MSG_DONTWAIT) == SOCKET_ERROR && CSERROR == CSEWOULDBLOCK);
+        }
+#endif // __linux__
+
+        if (readReady && ws.onRead)
+        {
+            if (!priority)
+            {
+                socket->mReadBudget = dispatchPolicy.readsPerTick > 0 ? dispatchPolicy.readsPerTick : -1;
+                socket->mByteBudget = dispatchPolicy.bytesPerTick > 0 ? dispatchPolicy.bytesPerTick : -1;
+
+                // The manager's receive allowance works as a byte budget that is charged once the callback returns
+                uint64_t allowance = receiveLimit.Available();
+                if (allowance < static_cast<uint64_t>(INT_MAX) && (socket->mByteBudget < 0 || allowance < static_cast<uint64_t>(socket->mByteBudget)))
+                {
+                    socket->mByteBudget = static_cast<int>(allowance);
+                }
+            }
+            socket->mBudgetExhausted = false;
+            uint64_t receivedBefore = socket->mBytesReceived;
+            socket->mFirstArrival = 0;
+            int id = ws.id;
+            uint64_t callbackStart = latencyObserver ? RealtimeNanos() : 0;
+
+            ws.onRead(*socket); // Run the onRead callback
+            ++dispatched;
+
+            if (latencyObserver && socket->mFirstArrival != 0)
+            {
+                latencyObserver(EventLatency{id, socket->mFirstArrival, wakeupTime, callbackStart, RealtimeNanos()});
+            }
+
+            uint64_t received = socket->mBytesReceived - receivedBefore;
+            rateStats.bytesReceived += received;
+            if (!priority)
+            {
+                receiveLimit.Consume(received);
+            }
+            if (socket->mBudgetExhausted)
+            {
+                ++loopStats.budgetStops;
+            }
+            socket->mReadBudget = -1;
+            socket->mByteBudget = -1;
+        }
+        if (writeReady && onWrite && socket->GetRawSocket() != INVALID_SOCKET)
+        {
+            onWrite(*socket);
+            ++dispatched;
+        }
+        return dispatched;
+    }
+
+    /**
+     * @brief Flush queued output as far as the rate limits allow, without letting a broken connection escape the event loop
+     *
+     * A failed Socket is only closed. It does not go through Socket::Error(), which would also shut down CrossSocket for every other Socket
+     *
+     * @param ws Watched Socket to flush
+     * @return False if the Socket failed and was closed
+     */
+    bool SocketManager::FlushOutput(WatchedSocket &ws)
+    {
+        uint64_t allowance = ws.priority ? std::numeric_limits<uint64_t>::max() : sendLimit.Available();
+        uint64_t sent;
+        int error;
+        bool flushed = ws.socket->FlushUpTo(OutputFlags, allowance, sent, error);
+        rateStats.bytesSent += sent;
+        if (!ws.priority)
+        {
+            sendLimit.Consume(sent);
+            if (!flushed && error == 0 && sent == allowance)
+            {
+                if (!ws.sendHeld)
+                {
+                    ++rateStats.sendThrottled;
+                }
+                ws.sendHeld = true;
+            }
+        }
+        if (error != 0)
+        {
+            CS_LOG_WARNING("Closing Socket {} after send failed with error {}", ws.id, error);
+            ws.socket->Close();
+            return false;
+        }
+        return true;
+    }
+
+    /**
+     * @brief Make a watched Socket a broadcast subscriber. The Socket is switched to nonblocking mode
+     *
+     * @param id Socket ID
+     * @param policy What to do once more than maxQueuedBytes are waiting to be sent
+     * @param maxQueuedBytes Bytes allowed to wait before the lag policy applies
+     */
+    void SocketManager::SetSubscriber(int id, LagPolicy policy, size_t maxQueuedBytes)
+    {
+        WatchedSocket &ws = sockets[id];
+        ws.subscriber = true;
+        ws.lagPolicy = policy;
+        ws.maxQueuedBytes = maxQueuedBytes;
+        ws.socket->SetNonblockingMode(true); // A blocking send to one slow subscriber would stall every other one
+    }
+
+    /**
+     * @brief Queue one payload on every subscriber without copying it
+     *
+     * @param payload Payload to send
+     * @return Number of subscribers the payload was queued on
+     */
+    int SocketManager::Broadcast(const SharedPayload &payload)
+    {
+        std::vector<int> ids;
+        for (WatchedSocket &ws : sockets)
+        {
+            if (ws.subscriber)
+            {
+                ids.push_back(ws.id);
+            }
+        }
+        return Broadcast(payload, ids);
+    }
+
+    /**
+     * @brief Queue one payload on specific subscribers without copying it
+     *
+     * @param payload Payload to send
+     * @param ids IDs of the subscribers to send to
+     * @return Number of subscribers the payload was queued on
+     */
+    int SocketManager::Broadcast(const SharedPayload &payload, const std::vector<int> &ids)
+    {
+        int queued = 0;
+        std::vector<int> disconnect;
+
+        for (int id : ids)
+        {
+            WatchedSocket &ws = sockets[id];
+            Socket &socket = *ws.socket;
+
+            // A subscriber with nothing waiting always takes the payload, even one bigger than its limit
+            size_t pending = socket.PendingSendBytes();
+            if (pending > 0 && pending + payload->size() > ws.maxQueuedBytes)
+            {
+                if (ws.lagPolicy == LagPolicy::Drop)
+                {
+                    ++broadcastStats.dropped;
+                    continue;
+                }
+                if (ws.lagPolicy == LagPolicy::Disconnect)
+                {
+                    disconnect.push_back(id);
+                    continue;
+                }
+                broadcastStats.coalesced += socket.DropUnsentPayloads();
+            }
+
+            socket.QueuePayload(payload, true);
+            ++queued;
+            ++broadcastStats.queued;
+
+            if (!FlushOutput(ws))
+            {
+                disconnect.push_back(id);
+            }
+        }
+
+        // Close from the highest ID down so the IDs still to be closed do not shift
+        std::sort(disconnect.begin(), disconnect.end());
+        disconnect.erase(std::unique(disconnect.begin(), disconnect.end()), disconnect.end());
+        for (auto it = disconnect.rbegin(); it != disconnect.rend(); ++it)
+        {
+            CloseSocket(*it);
+            ++broadcastStats.disconnected;
+        }
+        return queued;
+    }
+
+    /**
+     * @brief Limit how fast queued output is sent across all Sockets, on top of each Socket's own limit. Control-plane Sockets are exempt
+     *
+     * @param bytesPerSecond Sustained rate. 0 removes the limit
+     * @param burstBytes Largest burst allowed after an idle period. 0 picks 100 ms worth of the rate
+     */
+    void SocketManager::SetSendRateLimit(uint64_t bytesPerSecond, uint64_t burstBytes)
+    {
+        sendLimit.SetRate(bytesPerSecond, burstBytes);
+        rateStats.sendRate = bytesPerSecond;
+    }
+
+    /**
+     * @brief Limit how fast data is received across all Sockets, on top of each Socket's own limit. Control-plane Sockets are exempt
+     *
+     * @param bytesPerSecond Sustained rate. 0 removes the limit
+     * @param burstBytes Largest burst allowed after an idle period. 0 picks 100 ms worth of the rate
+     */
+    void SocketManager::SetReceiveRateLimit(uint64_t bytesPerSecond, uint64_t burstBytes)
+    {
+        receiveLimit.SetRate(bytesPerSecond, burstBytes);
+        rateStats.receiveRate = bytesPerSecond;
+    }
+
+    /**
+     * @brief Get the traffic the event loop has moved and how often the SocketManager limits held it back
+     *
+     * @return Rate statistics
+     */
+    RateStats SocketManager::GetRateStats() const
+    {
+        return rateStats;
+    }
+
+    /**
+     * @brief Report the arrival-to-callback timeline of every onRead callback that read timestamped data
+     *
+     * @param onLatency Function pointer to call with each report (must take const EventLatency&). nullptr stops reporting
+     */
+    void SocketManager::SetLatencyObserver(void (*onLatency)(const EventLatency &))
+    {
+        latencyObserver = onLatency;
+    }
+
+    /**
+     * @brief Get counters describing what Broadcast() has done
+     *
+     * @return Broadcast statistics
+     */
+    BroadcastStats SocketManager::GetBroadcastStats() const
+    {
+        return broadcastStats;
+    }
+
+    /**
+     * @brief Set how RunOnce() shares each tick between Sockets
+     *
+     * @param policy Per-tick receive budgets and round-robin setting
+     */
+    void SocketManager::SetDispatchPolicy(const DispatchPolicy &policy)
+    {
+        dispatchPolicy = policy;
+        dispatchStart = 0;
+    }
+
+    /**
+     * @brief Mark a Socket as control-plane. Control-plane Sockets are dispatched first every tick and are not limited by the dispatch budgets
+     *
+     * @param id Socket ID
+     * @param priority True for control-plane. False for the normal class
+     */
+    void SocketManager::SetSocketPriority(int id, bool priority)
+    {
+        sockets[id].priority = priority;
     }
 
     /**
@@ -115,22 +883,115 @@ namespace CrossSocket
      */
     void SocketManager::RunLoop(bool *condition)
     {
-        if (condition == nullptr)
+        while (condition == nullptr || *condition)
         {
-            while (true)
+            if (lowLatency)
+            {
+                RunLowLatencyCycle(condition);
+            }
+            else
             {
                 RunOnce();
             }
         }
-        else
+    }
+
+    /**
+     * @brief Spin with zero-timeout polls until the spin budget runs out, then block once
+     *
+     * @param condition RunLoop() condition, checked between polls
+     */
+    void SocketManager::RunLowLatencyCycle(bool *condition)
+    {
+        using Clock = std::chrono::steady_clock;
+
+        bool sawEvent = false;
+        Clock::time_point deadline = Clock::now() + std::chrono::microseconds(spinBudgetMicros);
+        while (condition == nullptr || *condition)
         {
-            while (*condition)
+            ++loopStats.spinPolls;
+            if (RunOnce(0) > 0)
             {
-                RunOnce();
+                ++loopStats.spinHits;
+                sawEvent = true;
+                deadline = Clock::now() + std::chrono::microseconds(spinBudgetMicros); // Traffic is flowing, keep spinning
+            }
+            else if (Clock::now() >= deadline)
+            {
+                break;
+            }
+        }
+
+        // A spin that found nothing halves the next budget so idle loops burn less CPU. Any event restores the full budget
+        if (sawEvent)
+        {
+            spinBudgetMicros = lowLatencyConfig.spinBudgetMicros;
+        }
+        else if (spinBudgetMicros / 2 >= lowLatencyConfig.minSpinBudgetMicros)
+        {
+            spinBudgetMicros /= 2;
+        }
+
+        if (condition != nullptr && !*condition)
+        {
+            return;
+        }
+
+        ++loopStats.blockingWaits;
+        if (RunOnce(lowLatencyConfig.idleTimeoutMillis) > 0)
+        {
+            ++loopStats.blockingWakeups;
+            spinBudgetMicros = lowLatencyConfig.spinBudgetMicros;
+        }
+    }
+
+    /**
+     * @brief Switch RunLoop() between blocking waits (default) and spinning with zero-timeout polls before blocking
+     *
+     * @param enable True to spin before blocking. False to always block in RunOnce()
+     * @param config Spin budget, idle timeout, and busy-poll settings. Busy polling is turned back off when the new mode does not use it
+     */
+    void SocketManager::SetLowLatencyMode(bool enable, const LowLatencyConfig &config)
+    {
+        bool wasBusyPolling = lowLatency && lowLatencyConfig.busyPollMicros > 0;
+        lowLatency = enable;
+        lowLatencyConfig = config;
+        spinBudgetMicros = config.spinBudgetMicros;
+
+        if (enable && config.busyPollMicros > 0)
+        {
+            for (WatchedSocket &ws : sockets)
+            {
+                ws.socket->SetBusyPoll(config.busyPollMicros, config.preferBusyPoll);
+            }
+        }
+        else if (wasBusyPolling) // Undo what the previous mode applied
+        {
+            for (WatchedSocket &ws : sockets)
+            {
+                ws.socket->SetBusyPoll(0, false);
             }
         }
     }
 
+    /**
+     * @brief Get counters describing how the event loop has been waking up
+     *
+     * @return Loop statistics since the last ResetLoopStats()
+     */
+    LoopStats SocketManager::GetLoopStats() const
+    {
+        return loopStats;
+    }
+
+    /**
+     * @brief Reset the loop statistics to zero
+     */
+    void SocketManager::ResetLoopStats()
+    {
+        loopStats = LoopStats{};
+    }
+
     /**
      * @brief Remove a socket from the event loop
      *
@@ -157,5 +1018,21 @@ namespace CrossSocket
         }
         sockets.clear();
         sockets.resize(0);
+
+#ifdef __linux__
+        for (WatchedRing &wr : rings)
+        {
+            wr.ring->Close();
+        }
+        rings.clear();
+
+        for (WatchedRelay &relay : relays)
+        {
+            ReleaseRelay(relay);
+            relay.directions[0].from->Close();
+            relay.directions[1].from->Close();
+        }
+        relays.clear();
+#endif // __linux__
     }
 }